@@ -0,0 +1,218 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <unordered_map>
+#include <cctype>
+#include "token.hpp"
+
+// the lexer as it was before the packed tokens and the streaming scanner,
+// kept as the baseline lexerBench measures the current one against.
+// a Token of its own with a std::string value, and the per-character std::string path
+
+namespace baseline {
+    struct Token {
+        tokenType type;
+        size_t row;
+        size_t column;
+        std::string value;
+
+        Token(tokenType t, const std::string& v, size_t row, size_t column) :
+        type(t), row(row), column(column), value(v) {}
+    };
+
+    class Lexer {
+        public:
+            Lexer(std::string& sourceCode) : sourceCode(sourceCode) {};
+            std::vector<Token> tokenize();
+
+        private:
+            static std::unordered_map<std::string,tokenType> keywords;
+            static std::unordered_map<char,bool> symbols;
+            static std::unordered_map<char,char> escapeChars;
+            bool inString;
+            size_t row;
+            size_t column;
+            std::string sourceCode;
+
+            Token createToken(const std::string& str);
+            bool isSymbol(const char chr);
+            bool isKeyword(const std::string& token);
+    };
+
+    inline std::unordered_map<std::string,tokenType> Lexer::keywords = {
+        {"return",tokenType::RETURN},
+        {"if",tokenType::IF},
+        {"while",tokenType::WHILE},
+        {"struct",tokenType::STRUCT},
+        {";",tokenType::SEMICOLON},
+        {"+",tokenType::OPERATION},
+        {"-",tokenType::OPERATION},
+        {"*",tokenType::OPERATION},
+        {"/",tokenType::OPERATION},
+        {"%",tokenType::OPERATION},
+        {"&",tokenType::OPERATION},
+        {"(",tokenType::PARENTHESES},
+        {")",tokenType::PARENTHESES},
+        {"{",tokenType::CURLY_BRACKET},
+        {"}",tokenType::CURLY_BRACKET},
+        {"[",tokenType::SQUARE_BRACKET},
+        {"]",tokenType::SQUARE_BRACKET},
+        {",",tokenType::COMMA},
+        {".",tokenType::DOT},
+        {"=",tokenType::ASSIGNMENT},
+        {"==",tokenType::COMPARISON},
+        {"!=",tokenType::COMPARISON},
+        {">",tokenType::COMPARISON},
+        {"<",tokenType::COMPARISON},
+        {">=",tokenType::COMPARISON},
+        {"<=",tokenType::COMPARISON},
+        {"int",tokenType::TYPE},
+        {"void",tokenType::TYPE},
+        {"uint64_t",tokenType::TYPE},
+        {"uint32_t",tokenType::TYPE},
+        {"uint16_t",tokenType::TYPE},
+        {"uint8_t",tokenType::TYPE},
+        {"char",tokenType::TYPE}
+    };
+
+    inline std::unordered_map<char,bool> Lexer::symbols = {
+        {'+',true},
+        {'-',true},
+        {'*',true},
+        {'/',true},
+        {'%',true},
+        {'(',true},
+        {')',true},
+        {'{',true},
+        {'}',true},
+        {'[',true},
+        {']',true},
+        {',',true},
+        {';',true},
+        {'=',true},
+        {'&',true},
+        {'<',true},
+        {'>',true},
+        {'.',true},
+    };
+
+    inline std::unordered_map<char,char> Lexer::escapeChars = {
+        {'n','\n'}, // new line
+        {'r','\r'}, // carriage return
+        {'t','\t'}, // tab
+        {'v','\v'}, // vertical tab
+        {'a','\a'}, // alert
+    };
+
+    inline std::vector<Token> Lexer::tokenize() {
+        std::vector<Token> tokens;
+        std::string current;
+        inString = false;
+        row = 1;
+        column = 0;
+        try {
+            for (size_t i = 0; i < sourceCode.size(); ++i) {
+                ++column;
+                char ch = sourceCode[i];
+
+                if (ch == '\n' || ch == '\r' || ch == '\t') { 
+                    if (ch == '\t') {
+                        column += 4;
+                    }
+                    else {
+                        ++row;
+                        column = 0;
+                    }
+                    current.clear();
+                    continue;
+                }
+
+                if (inString) {
+                    if (ch == '\"') { // string end
+                        tokens.push_back(createToken(current));
+                        current.clear();
+                        inString = false;
+                        continue;
+                    }
+                    if (ch == '\\') { // escape char
+                        ++i;
+                        ch = sourceCode[i];
+                        if (escapeChars.find(ch) != escapeChars.end()) {
+                            current += escapeChars[ch];
+                            continue;
+                        }
+                    }
+                    current += ch;
+                    continue;
+                }
+
+                if (ch == '\"') { // string start
+                    inString = true;
+                    continue;
+                }
+
+                if (ch == '\'') { // char
+                    ++i;
+                    ch = sourceCode[i];
+                    tokens.push_back(createToken(std::to_string(ch)));
+                    ++i;
+                    continue;
+                }
+
+                if (isSymbol(ch))  {
+                    if (!current.empty()) {
+                        tokens.push_back(createToken(current));
+                        current.clear();
+                    }
+                    if (isKeyword(std::string(1,ch) + sourceCode[i+1])) { // 2 chars symbol
+                        ++i;
+                        tokens.push_back(createToken(std::string(1,ch) + sourceCode[i]));
+                    }
+                    else {
+                        tokens.push_back(createToken(std::string(1,ch)));
+                    }
+                    continue;
+                }
+
+                if (ch == ' ') {
+                    if (!current.empty()) {
+                        tokens.push_back(createToken(current));
+                    }
+                    current.clear();
+                    continue;
+                }
+
+                current += ch;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "line: " << row << " column: " << column << 
+            "\nerror while tokenizing: " << current << std::endl; 
+            exit(1);
+        }
+        return tokens;
+    }
+
+    inline Token Lexer::createToken(const std::string& str) {
+        size_t col = column - str.size();
+        if (inString) { 
+            return Token(tokenType::STRING, str, row, col);
+        }
+        else if (isKeyword(str)) {
+            return Token(keywords[str], str, row, col);
+        }
+        else if (std::isdigit(str[0])) { 
+            return Token(tokenType::CONSTANT, str, row, col);
+        } 
+        return Token(tokenType::NAME, str, row, col);
+    }
+
+    inline bool Lexer::isSymbol(const char chr) {
+        return symbols.find(chr) != symbols.end();
+    }
+
+    inline bool Lexer::isKeyword(const std::string& token) {
+        return keywords.find(token) != keywords.end();
+    }
+}
\ No newline at end of file
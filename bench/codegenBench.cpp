@@ -0,0 +1,104 @@
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "astArena.hpp"
+#include "flatAST.hpp"
+#include "codeGen.hpp"
+
+// usage: codegenBench [tree|flat] [functions]
+// without a mode, runs both modes in child processes so neither runs on the other's heap.
+// the sizes are the encodings' own bytes, the process RSS would be mostly source, tokens and parser
+
+std::string generateProgram(size_t functions) {
+    std::string source = "struct Pair {\n    uint64_t first;\n    uint64_t second;\n};\n\n";
+    for (size_t i = 0; i < functions; ++i) {
+        std::string n = std::to_string(i);
+        source += "uint64_t function" + n + "(uint64_t a, uint64_t b) {\n";
+        source += "    uint64_t result;\n";
+        source += "    char buffer[32];\n";
+        source += "    struct Pair pair;\n";
+        source += "    result = a * 3 + b - " + n + " / 2 + a % 7;\n";
+        source += "    pair.first = result;\n";
+        source += "    buffer[a] = b;\n";
+        source += "    while (result >= 100) {\n";
+        source += "        result = result / 2 + buffer[1];\n";
+        source += "    }\n";
+        source += "    if (result < pair.first) {\n";
+        source += "        printf(\"value %d\\n\", result);\n";
+        source += "    }\n";
+        if (i > 0) {
+            source += "    result = function" + std::to_string(i - 1) + "(result, b + 1);\n";
+        }
+        source += "    return result;\n";
+        source += "}\n\n";
+    }
+    return source;
+}
+
+int runMode(const std::string& mode, size_t functions) {
+    std::string source = generateProgram(functions);
+    StringTable strings;
+    Lexer lexer = Lexer(source,strings);
+    std::vector<Token> tokens = lexer.tokenize();
+    ASTArena arena;
+    Parser parser = Parser(std::move(tokens),strings,arena);
+    ProgramRoot* root = parser.parse();
+
+    CodeGen codeGen = CodeGen();
+    codeGen.entryFunctionName = "main";
+    size_t arenaBytes = arena.bytesUsed();
+    size_t flatBytes = 0;
+    double flattenSeconds = 0;
+    double codegenSeconds = 0;
+    bool success;
+    if (mode == "flat") {
+        auto start = std::chrono::steady_clock::now();
+        FlatAST flatAST;
+        flatAST.reserve(arena.totalNodes());
+        flatAST.build(root);
+        flatBytes = flatAST.memoryBytes();
+        arena.release();
+        auto middle = std::chrono::steady_clock::now();
+        success = codeGen.generateObjectFile(flatAST,"codegenBench.o");
+        auto end = std::chrono::steady_clock::now();
+        flattenSeconds = std::chrono::duration<double>(middle - start).count();
+        codegenSeconds = std::chrono::duration<double>(end - middle).count();
+    }
+    else {
+        auto start = std::chrono::steady_clock::now();
+        success = codeGen.generateObjectFile(root,"codegenBench.o");
+        auto end = std::chrono::steady_clock::now();
+        codegenSeconds = std::chrono::duration<double>(end - start).count();
+    }
+    if (!success) {
+        std::cerr << "Error while making object file codegenBench.o\n";
+        return 1;
+    }
+    std::cout << mode << ": " << functions << " functions, codegen " << codegenSeconds * 1000 << " ms, "
+    << "flatten " << flattenSeconds * 1000 << " ms, arena " << arenaBytes / 1024 << " KB";
+    if (mode == "flat") {
+        std::cout << ", flat arrays " << flatBytes / 1024 << " KB";
+    }
+    std::cout << "\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    size_t functions = (argc >= 3) ? std::stoul(argv[2]) : 100000;
+    if (argc >= 2) {
+        std::string mode = argv[1];
+        if (mode != "tree" && mode != "flat") {
+            std::cerr << "Unknown mode " << mode << ", usage: codegenBench [tree|flat] [functions]\n";
+            return 1;
+        }
+        return runMode(mode,functions);
+    }
+    std::string self = argv[0];
+    int result = std::system(("\"" + self + "\" tree " + std::to_string(functions)).c_str());
+    result |= std::system(("\"" + self + "\" flat " + std::to_string(functions)).c_str());
+    return result != 0;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+// long expressions, mostly temporaries and constants
+uint64_t mix(uint64_t a, uint64_t b, uint64_t c) {
+    return a * 31 + b * 17 - c + a / 3 + b % 11 * c;
+}
+
+int main() {
+    uint64_t i;
+    uint64_t a;
+    uint64_t b;
+    uint64_t h;
+    h = 7;
+    a = 1;
+    b = 2;
+    i = 0;
+    while (i < 20000000) {
+        a = a * 3 + b - i % 5 + 12;
+        b = b + a / 7 * 2 + i;
+        h = h + mix(a, b, i) % 1000003;
+        a = a % 65536;
+        b = b % 65536;
+        i = i + 1;
+    }
+    printf("%d %d %d\n", a, b, h);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+// fills and sums a local array, over and over
+int main() {
+    uint64_t values[512];
+    uint64_t i;
+    uint64_t round;
+    uint64_t sum;
+    round = 0;
+    sum = 0;
+    while (round < 400000) {
+        i = 0;
+        while (i < 64) {
+            values[i] = i * 3 + round;
+            i = i + 1;
+        }
+        i = 0;
+        while (i < 64) {
+            sum = values[i] % 7 + sum;
+            i = i + 1;
+        }
+        round = round + 1;
+    }
+    printf("%d\n", sum);
+    return 0;
+}
\ No newline at end of file
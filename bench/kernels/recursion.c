@@ -0,0 +1,27 @@
+// call heavy, the prologue and epilogue dominate
+uint64_t fib(uint64_t n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+uint64_t sumDown(uint64_t n, uint64_t acc) {
+    if (n == 0) {
+        return acc;
+    }
+    return sumDown(n - 1, acc + n);
+}
+
+int main() {
+    uint64_t i;
+    uint64_t total;
+    total = 0;
+    i = 0;
+    while (i < 2000) {
+        total = total + sumDown(1000, i);
+        i = i + 1;
+    }
+    printf("%d %d\n", fib(32), total);
+    return 0;
+}
\ No newline at end of file
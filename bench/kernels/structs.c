@@ -0,0 +1,36 @@
+// updates the fields of a local struct in a loop
+struct Particle {
+    uint64_t x;
+    uint64_t y;
+    uint64_t vx;
+    uint64_t vy;
+    char alive;
+};
+
+int main() {
+    struct Particle p;
+    uint64_t i;
+    uint64_t bounces;
+    p.x = 0;
+    p.y = 0;
+    p.vx = 3;
+    p.vy = 5;
+    p.alive = 1;
+    bounces = 0;
+    i = 0;
+    while (i < 30000000) {
+        p.x = p.x + p.vx;
+        p.y = p.y + p.vy;
+        if (p.x > 100000) {
+            p.x = p.x - 100000;
+            bounces = bounces + p.alive;
+        }
+        if (p.y > 100000) {
+            p.y = p.y - 100000;
+            bounces = bounces + p.alive;
+        }
+        i = i + 1;
+    }
+    printf("%d %d %d\n", p.x, p.y, bounces);
+    return 0;
+}
\ No newline at end of file
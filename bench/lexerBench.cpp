@@ -0,0 +1,91 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include "lexer.hpp"
+#include "baselineLexer.hpp"
+
+// usage: lexerBench [file] [iterations]
+// without a file, lexes a generated source of about 8 MB.
+// the baseline is the lexer from before the packed tokens, the speedups are against it
+
+std::string generateSource(size_t targetSize) {
+    std::string source;
+    size_t i = 0;
+    while (source.size() < targetSize) {
+        std::string n = std::to_string(i);
+        source += "uint64_t function" + n + "(uint64_t a, uint64_t b) {\n";
+        source += "    uint64_t result" + n + ";\n";
+        source += "    char buffer[64];\n";
+        source += "    result" + n + " = a * 3 + b - " + n + ";\n";
+        source += "    while (result" + n + " >= 100) {\n";
+        source += "        result" + n + " = result" + n + " / 2;\n";
+        source += "    }\n";
+        source += "    printf(\"value %d\\n\", result" + n + ");\n";
+        source += "    return result" + n + ";\n";
+        source += "}\n\n";
+        ++i;
+    }
+    return source;
+}
+
+template <typename F>
+double bestSeconds(size_t iterations, F run) {
+    double best = 1e30;
+    for (size_t i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    std::string source;
+    if (argc >= 2) {
+        std::ifstream fileStream(argv[1], std::ios::binary);
+        if (!fileStream.is_open()) {
+            std::cerr << "Error opening file: " << argv[1] << "\n";
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << fileStream.rdbuf();
+        source = buffer.str();
+    }
+    else {
+        source = generateSource(8 * 1024 * 1024);
+    }
+    size_t iterations = (argc >= 3) ? std::stoul(argv[2]) : 5;
+    double megabytes = source.size() / (1024.0 * 1024.0);
+
+    size_t baselineCount = 0;
+    double baselineTime = bestSeconds(iterations, [&]() {
+        baseline::Lexer lexer = baseline::Lexer(source);
+        baselineCount = lexer.tokenize().size();
+    });
+
+    size_t tokenCount = 0;
+    double tokenizeTime = bestSeconds(iterations, [&]() {
+        StringTable strings;
+        Lexer lexer = Lexer(source,strings);
+        tokenCount = lexer.tokenize().size();
+    });
+
+    size_t viewCount = 0;
+    double viewsTime = bestSeconds(iterations, [&]() {
+        StringTable strings;
+        Lexer lexer = Lexer(source.data(),source.size(),strings);
+        viewCount = lexer.tokenizeViews().size();
+    });
+
+    std::cout << "source: " << megabytes << " MB, best of " << iterations << "\n";
+    std::cout << "baseline:            " << baselineCount << " tokens, " << megabytes / baselineTime << " MB/s\n";
+    std::cout << "tokenize (interned): " << tokenCount << " tokens, " << megabytes / tokenizeTime << " MB/s, "
+    << baselineTime / tokenizeTime << "x\n";
+    std::cout << "tokenizeViews:       " << viewCount << " tokens, " << megabytes / viewsTime << " MB/s, "
+    << baselineTime / viewsTime << "x\n";
+    return 0;
+}
\ No newline at end of file
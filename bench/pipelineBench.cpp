@@ -0,0 +1,252 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include "preprocessor.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "astArena.hpp"
+#include "codeGen.hpp"
+
+// usage: pipelineBench [workload|all] [scale] [iterations] [--json]
+// workloads: functions, expressions, structs, loops, strings, mixed.
+// times every stage of the compiler on a generated program, best of the iterations.
+// with --json, prints one JSON object per workload instead of the table
+
+static const char* workloads[] = {"functions", "expressions", "structs", "loops", "strings", "mixed"};
+
+// many small functions calling each other
+std::string generateFunctions(size_t scale) {
+    std::string source;
+    for (size_t i = 0; i < scale; ++i) {
+        std::string n = std::to_string(i);
+        source += "uint64_t function" + n + "(uint64_t a, uint64_t b, uint64_t c) {\n";
+        source += "    uint64_t result;\n";
+        source += "    result = a + b * 3 - c + " + n + ";\n";
+        if (i > 0) {
+            source += "    result = function" + std::to_string(i - 1) + "(result, a, b);\n";
+        }
+        source += "    return result;\n";
+        source += "}\n\n";
+    }
+    return source;
+}
+
+// long left to right chains, the dialect has no parentheses or precedence
+std::string generateExpressions(size_t scale) {
+    static const char* operators[] = {" + ", " - ", " * ", " / ", " % ", " + "};
+    std::string source;
+    for (size_t i = 0; i < scale; ++i) {
+        std::string n = std::to_string(i);
+        source += "uint64_t expression" + n + "(uint64_t a, uint64_t b) {\n";
+        source += "    uint64_t x;\n";
+        source += "    x = a";
+        for (size_t j = 0; j < 64; ++j) {
+            source += operators[(i + j) % 6];
+            source += (j % 3 == 0) ? "b" : (j % 3 == 1) ? std::to_string(j + 1) : "a";
+        }
+        source += ";\n";
+        source += "    return x;\n";
+        source += "}\n\n";
+    }
+    return source;
+}
+
+// structs with many fields, written and read back field by field
+std::string generateStructs(size_t scale) {
+    std::string source;
+    for (size_t i = 0; i < scale; ++i) {
+        std::string n = std::to_string(i);
+        source += "struct Record" + n + " {\n";
+        for (size_t j = 0; j < 32; ++j) {
+            source += (j % 4 == 0) ? "    char" : "    uint64_t";
+            source += " field" + std::to_string(j) + ";\n";
+        }
+        source += "};\n\n";
+        source += "uint64_t record" + n + "(uint64_t a) {\n";
+        source += "    struct Record" + n + " r;\n";
+        source += "    uint64_t sum;\n";
+        for (size_t j = 0; j < 32; ++j) {
+            source += "    r.field" + std::to_string(j) + " = a + " + std::to_string(j) + ";\n";
+        }
+        source += "    sum = 0;\n";
+        for (size_t j = 0; j < 32; ++j) {
+            source += "    sum = sum + r.field" + std::to_string(j) + ";\n";
+        }
+        source += "    return sum;\n";
+        source += "}\n\n";
+    }
+    return source;
+}
+
+// while loops with long bodies and nested conditions
+std::string generateLoops(size_t scale) {
+    std::string source;
+    for (size_t i = 0; i < scale; ++i) {
+        std::string n = std::to_string(i);
+        source += "uint64_t loop" + n + "(uint64_t count) {\n";
+        source += "    uint64_t i;\n";
+        source += "    uint64_t s;\n";
+        source += "    char buffer[64];\n";
+        source += "    i = 0;\n";
+        source += "    s = 0;\n";
+        source += "    while (i < count) {\n";
+        for (size_t j = 0; j < 16; ++j) {
+            std::string m = std::to_string(j);
+            source += "        s = s + i * " + m + " - " + m + ";\n";
+            source += "        buffer[" + std::to_string(j * 4) + "] = s;\n";
+            if (j % 4 == 0) {
+                source += "        if (s > " + std::to_string(1000 * (j + 1)) + ") {\n";
+                source += "            s = s / 2;\n";
+                source += "        }\n";
+            }
+        }
+        source += "        i = i + 1;\n";
+        source += "    }\n";
+        source += "    return s;\n";
+        source += "}\n\n";
+    }
+    return source;
+}
+
+// printf calls with long literals, many of them repeated
+std::string generateStrings(size_t scale) {
+    std::string source;
+    for (size_t i = 0; i < scale; ++i) {
+        std::string n = std::to_string(i);
+        source += "uint64_t strings" + n + "(uint64_t a) {\n";
+        for (size_t j = 0; j < 16; ++j) {
+            std::string text = "message " + std::to_string((i * 16 + j) % 97) + " of the strings workload, value %d\\n";
+            source += "    printf(\"" + text + "\", a);\n";
+        }
+        source += "    return a;\n";
+        source += "}\n\n";
+    }
+    return source;
+}
+
+std::string generateWorkload(const std::string& workload, size_t scale) {
+    if (workload == "functions") return generateFunctions(scale);
+    if (workload == "expressions") return generateExpressions(scale);
+    if (workload == "structs") return generateStructs(scale);
+    if (workload == "loops") return generateLoops(scale);
+    if (workload == "strings") return generateStrings(scale);
+    return generateFunctions(scale / 5) + generateExpressions(scale / 5) + generateStructs(scale / 5)
+    + generateLoops(scale / 5) + generateStrings(scale / 5);
+}
+
+struct StageTimes {
+    double preprocess = 1e30;
+    double tokenize = 1e30;
+    double parse = 1e30;
+    double codegen = 1e30;
+    double write = 1e30;
+    double total() const { return preprocess + tokenize + parse + codegen + write; }
+};
+
+template <typename F>
+double seconds(F run) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int runWorkload(const std::string& workload, size_t scale, size_t iterations, bool json) {
+    std::string source = generateWorkload(workload, scale);
+    source += "int main() {\n    return 0;\n}\n";
+    std::string sourceFile = "pipelineBench.c";
+    {
+        std::ofstream out(sourceFile, std::ios::binary);
+        out << source;
+    }
+    size_t lines = std::count(source.begin(), source.end(), '\n');
+
+    StageTimes best;
+    size_t tokenCount = 0;
+    size_t nodeCount = 0;
+    size_t textBytes = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        std::string preprocessed;
+        best.preprocess = std::min(best.preprocess, seconds([&]() {
+            std::ifstream fileStream(sourceFile);
+            Preprocessor preprocessor = Preprocessor();
+            preprocessed = preprocessor.preProcess(fileStream);
+        }));
+        StringTable strings;
+        std::vector<Token> tokens;
+        best.tokenize = std::min(best.tokenize, seconds([&]() {
+            Lexer lexer = Lexer(preprocessed,strings);
+            tokens = lexer.tokenize();
+        }));
+        tokenCount = tokens.size();
+        ASTArena arena;
+        ProgramRoot* root = nullptr;
+        best.parse = std::min(best.parse, seconds([&]() {
+            Parser parser = Parser(std::move(tokens),strings,arena);
+            root = parser.parse();
+        }));
+        nodeCount = arena.totalNodes();
+        CodeGen codeGen = CodeGen();
+        codeGen.entryFunctionName = "main";
+        std::vector<uint8_t> textData;
+        best.codegen = std::min(best.codegen, seconds([&]() {
+            textData = codeGen.generateText(root);
+        }));
+        textBytes = textData.size();
+        bool success = true;
+        best.write = std::min(best.write, seconds([&]() {
+            success = codeGen.writeObjectFile(textData,"pipelineBench.o");
+        }));
+        if (!success) {
+            std::cerr << "Error while making object file pipelineBench.o\n";
+            return 1;
+        }
+    }
+
+    double total = best.total();
+    if (json) {
+        std::cout << "{\"workload\": \"" << workload << "\", \"scale\": " << scale << ", \"iterations\": " << iterations
+        << ", \"lines\": " << lines << ", \"bytes\": " << source.size() << ", \"tokens\": " << tokenCount
+        << ", \"astNodes\": " << nodeCount << ", \"textBytes\": " << textBytes
+        << ", \"seconds\": {\"preprocess\": " << best.preprocess << ", \"tokenize\": " << best.tokenize
+        << ", \"parse\": " << best.parse << ", \"codegen\": " << best.codegen << ", \"write\": " << best.write
+        << ", \"total\": " << total << "}, \"linesPerSecond\": " << lines / total
+        << ", \"bytesPerSecond\": " << source.size() / total << "}\n";
+        return 0;
+    }
+    std::cout << workload << ": " << lines << " lines, " << source.size() / 1024 << " KB, " << tokenCount << " tokens, "
+    << nodeCount << " nodes, " << textBytes / 1024 << " KB of code, best of " << iterations << "\n";
+    std::cout << "  preprocess " << best.preprocess * 1000 << " ms, tokenize " << best.tokenize * 1000
+    << " ms, parse " << best.parse * 1000 << " ms, codegen " << best.codegen * 1000 << " ms, write "
+    << best.write * 1000 << " ms\n";
+    std::cout << "  total " << total * 1000 << " ms, " << (size_t)(lines / total) << " lines/s, "
+    << source.size() / total / (1024 * 1024) << " MB/s\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args;
+    bool json = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json = true;
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+    std::string workload = args.size() >= 1 ? args[0] : "all";
+    size_t scale = args.size() >= 2 ? std::stoul(args[1]) : 2000;
+    size_t iterations = args.size() >= 3 ? std::stoul(args[2]) : 3;
+    int result = 0;
+    for (const char* name : workloads) {
+        if (workload == "all" || workload == name) {
+            result |= runWorkload(name, scale, iterations, json);
+        }
+    }
+    return result;
+}
\ No newline at end of file
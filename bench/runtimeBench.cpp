@@ -0,0 +1,274 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include <cstdint>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// usage: runtimeBench [--compiler path] [--kernels directory] [--runs n] [--json] [flags...]
+// compiles every kernel in the directory with each set of compiler flags (a quoted
+// argument, "" for none), links it with cc and runs it. reports the best wall time
+// of the runs, and instructions and cycles from the perf counters where linux allows.
+// the first set of flags is the baseline, the others must print the same output
+
+namespace fs = std::filesystem;
+
+struct RunResult {
+    bool success = false;
+    double seconds = 0;
+    int64_t instructions = -1; // -1 when the counters are unavailable
+    int64_t cycles = -1;
+    std::string output;
+};
+
+#ifdef __linux__
+int openCounter(pid_t pid, uint64_t config) {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1; // counts from the exec of the kernel on
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+int64_t readCounter(int fd) {
+    int64_t value = -1;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        value = -1;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return value;
+}
+
+// the child waits on a pipe until the counters are attached to it
+RunResult runBinary(const std::string& path) {
+    RunResult result;
+    int output[2];
+    int go[2];
+    if (pipe(output) != 0) {
+        return result;
+    }
+    if (pipe(go) != 0) {
+        close(output[0]);
+        close(output[1]);
+        return result;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(output[0]);
+        close(output[1]);
+        close(go[0]);
+        close(go[1]);
+        return result;
+    }
+    if (pid == 0) {
+        close(go[1]);
+        close(output[0]);
+        char ready;
+        if (read(go[0], &ready, 1) != 1) {
+            _exit(127);
+        }
+        dup2(output[1], 1);
+        execl(path.c_str(), path.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    close(go[0]);
+    close(output[1]);
+    int instructions = openCounter(pid, PERF_COUNT_HW_INSTRUCTIONS);
+    int cycles = openCounter(pid, PERF_COUNT_HW_CPU_CYCLES);
+
+    auto start = std::chrono::steady_clock::now();
+    // if the child never gets the go byte it sees eof and exits with 127
+    bool started = write(go[1], "x", 1) == 1;
+    close(go[1]);
+    char buffer[4096];
+    ssize_t size;
+    while ((size = read(output[0], buffer, sizeof(buffer))) > 0) {
+        result.output.append(buffer, size);
+    }
+    close(output[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    auto end = std::chrono::steady_clock::now();
+
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.instructions = readCounter(instructions);
+    result.cycles = readCounter(cycles);
+    result.success = started && WIFEXITED(status) && WEXITSTATUS(status) != 127;
+    return result;
+}
+#else
+// no counters, and the ELF objects only run on linux anyway
+RunResult runBinary(const std::string& path) {
+    RunResult result;
+    std::string outputFile = path + ".out";
+    auto start = std::chrono::steady_clock::now();
+    int status = std::system(("\"" + path + "\" > \"" + outputFile + "\"").c_str());
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    std::ifstream file(outputFile);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    result.output = buffer.str();
+    result.success = status != -1;
+    return result;
+}
+#endif
+
+std::string jsonString(const std::string& text) {
+    std::string result = "\"";
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            result += '\\';
+            result += ch;
+        }
+        else if (ch == '\n') {
+            result += "\\n";
+        }
+        else if ((unsigned char)ch >= 0x20) {
+            result += ch;
+        }
+    }
+    return result + "\"";
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    std::string compiler = "compiler.exe";
+#else
+    std::string compiler = "./compiler";
+#endif
+    std::string kernels = "bench/kernels";
+    size_t runs = 3;
+    bool json = false;
+    std::vector<std::string> configs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--compiler" && i + 1 < argc) {
+            compiler = argv[++i];
+        }
+        else if (arg == "--kernels" && i + 1 < argc) {
+            kernels = argv[++i];
+        }
+        else if (arg == "--runs" && i + 1 < argc) {
+            runs = std::max(std::stoul(argv[++i]), 1ul);
+        }
+        else if (arg == "--json") {
+            json = true;
+        }
+        else {
+            configs.push_back(arg);
+        }
+    }
+    if (configs.empty()) {
+        configs = {"", "-O", "--ir", "-O --ir"};
+    }
+    const char* linker = std::getenv("CC") ? std::getenv("CC") : "cc";
+    compiler = fs::absolute(compiler).string();
+
+    std::vector<fs::path> sources;
+    std::error_code error;
+    for (const fs::directory_entry& file : fs::directory_iterator(kernels, error)) {
+        if (file.path().extension() == ".c") {
+            sources.push_back(file.path());
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+    if (sources.empty()) {
+        std::cerr << "No kernels in " << kernels << "\n";
+        return 1;
+    }
+    fs::path work = "runtimeBench.work";
+    fs::create_directories(work);
+
+    int failures = 0;
+    for (const fs::path& source : sources) {
+        std::string kernel = source.stem().string();
+        fs::path copy = work / source.filename();
+        fs::copy_file(source, copy, fs::copy_options::overwrite_existing);
+        std::string baselineOutput;
+        double baselineSeconds = 0;
+        if (!json) {
+            std::cout << kernel << ":\n";
+        }
+        for (size_t c = 0; c < configs.size(); ++c) {
+            const std::string& flags = configs[c];
+            fs::path object = work / (kernel + ".o");
+            fs::path binary = fs::absolute(work / kernel);
+            std::string compile = "\"" + compiler + "\" " + flags + " \"" + copy.string() + "\" > \"" + (work / "compile.log").string() + "\"";
+            std::string link = std::string(linker) + " -no-pie -z noexecstack \"" + object.string() + "\" -o \"" + binary.string() + "\"";
+            std::string problem;
+            RunResult best;
+            if (std::system(compile.c_str()) != 0) {
+                problem = "compile failed";
+            }
+            else if (std::system(link.c_str()) != 0) {
+                problem = "link failed";
+            }
+            else {
+                for (size_t run = 0; run < runs; ++run) {
+                    RunResult result = runBinary(binary.string());
+                    if (!result.success) {
+                        problem = "run failed";
+                        break;
+                    }
+                    if (run == 0 || result.seconds < best.seconds) {
+                        best = result;
+                    }
+                }
+            }
+            if (problem.empty() && c == 0) {
+                baselineOutput = best.output;
+                baselineSeconds = best.seconds;
+            }
+            else if (problem.empty() && best.output != baselineOutput) {
+                problem = "wrong output";
+            }
+            failures += !problem.empty();
+
+            if (json) {
+                std::cout << "{\"kernel\": " << jsonString(kernel) << ", \"flags\": " << jsonString(flags)
+                << ", \"ok\": " << (problem.empty() ? "true" : "false");
+                if (problem.empty()) {
+                    std::cout << ", \"seconds\": " << best.seconds << ", \"instructions\": " << best.instructions
+                    << ", \"cycles\": " << best.cycles << ", \"output\": " << jsonString(best.output);
+                }
+                else {
+                    std::cout << ", \"error\": " << jsonString(problem);
+                }
+                std::cout << "}\n";
+                continue;
+            }
+            std::cout << "  " << (flags.empty() ? "(no flags)" : flags) << ": ";
+            if (!problem.empty()) {
+                std::cout << problem << "\n";
+                continue;
+            }
+            std::cout << best.seconds * 1000 << " ms";
+            if (best.instructions >= 0 && best.cycles > 0) {
+                std::cout << ", " << best.instructions << " instructions, " << best.cycles << " cycles, "
+                << (double)best.instructions / best.cycles << " IPC";
+            }
+            if (c > 0 && baselineSeconds > 0) {
+                std::cout << ", " << baselineSeconds / best.seconds << "x the baseline";
+            }
+            std::cout << "\n";
+        }
+    }
+    return failures != 0;
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <cstdint>
 
 enum class NodeType {
     ReturnStatement,
@@ -30,6 +31,7 @@ enum class NodeType {
 struct ASTNode {
     virtual ~ASTNode() = default;
     NodeType type;
+    mutable uint32_t registerNeed = 0; // Sethi-Ullman number, filled in by codegen on first use
     virtual void print() const {};
 };
 
@@ -123,7 +125,7 @@ struct CodeBlock : public ASTNode {
 
 struct ProgramRoot : public ASTNode {
     std::vector<ASTNode*> programElements;
-    ProgramRoot() { type = NodeType::CodeBlock; }
+    ProgramRoot() { type = NodeType::ProgramRoot; }
     void print() const override {
         std::cout << "Program:\n";
         for (int i = 0; i < programElements.size(); ++i) {
@@ -219,6 +221,8 @@ struct Function : public ASTNode {
     std::string returnType;
     std::string name;
     std::vector<ASTNode*> parameters;
+    std::string tokenHash;               // of the tokens it was parsed from
+    std::vector<std::string> structsUsed; // structs named in those tokens
     Function() { type = NodeType::Function;}
     void print() const override {
         std::cout << "Function: " << name << ", ";
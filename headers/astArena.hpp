@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <new>
+#include <utility>
+#include "ASTnode.hpp"
+
+static const size_t NODE_TYPE_COUNT = (size_t)NodeType::PropertyAccess + 1;
+
+// bump allocator for the AST of one translation unit,
+// every node lives until the arena is released or destroyed
+class ASTArena {
+    public:
+        ASTArena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+        ~ASTArena() { release(); }
+        ASTArena(const ASTArena&) = delete;
+        ASTArena& operator=(const ASTArena&) = delete;
+
+        template <typename T, typename... Args>
+        T* make(Args&&... args) {
+            void* memory = allocate(sizeof(T), alignof(T));
+            T* node = new (memory) T(std::forward<Args>(args)...);
+            nodes.push_back(node);
+            ++nodeCount[(size_t)node->type];
+            nodeBytes[(size_t)node->type] += sizeof(T);
+            return node;
+        }
+
+        void release();
+        size_t totalNodes() const { return nodes.size(); }
+        size_t bytesUsed() const { return usedBytes; }
+        size_t bytesReserved() const { return reservedBytes; }
+        size_t nodesOfType(NodeType type) const { return nodeCount[(size_t)type]; }
+        size_t bytesOfType(NodeType type) const { return nodeBytes[(size_t)type]; }
+        void printStats(std::ostream& out) const;
+
+    private:
+        size_t blockSize;
+        std::vector<char*> blocks;
+        char* current = nullptr;
+        char* end = nullptr;
+        std::vector<ASTNode*> nodes; // for the std::string/std::vector members
+        size_t nodeCount[NODE_TYPE_COUNT] = {};
+        size_t nodeBytes[NODE_TYPE_COUNT] = {};
+        size_t usedBytes = 0;
+        size_t reservedBytes = 0;
+
+        void* allocate(size_t size, size_t alignment);
+};
\ No newline at end of file
@@ -1,7 +1,14 @@
 #pragma once
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <initializer_list>
 #include "ASTnode.hpp"
+#include "flatAST.hpp"
+#include "x86.hpp"
+#include "ir.hpp"
+#include "compileCache.hpp"
 
 #pragma pack(push, 1) // no padding between struct properties
 
@@ -54,9 +61,37 @@ struct Elf64_Rela {
 
 class CodeGen {
     public:
+        // bump with every change to the generated code, the compile cache is keyed on it
+        static constexpr uint32_t CODE_VERSION = 1;
         std::string entryFunctionName;
+        bool promoteLocals = false; // keep scalar locals in registers (-O)
+        bool useIR = false;         // lower through the SSA IR (--ir)
+        bool dumpIR = false;        // print the IR of dumpIRFunction, or of every function if empty
+        std::string dumpIRFunction;
+        unsigned jobs = 1;          // threads generating functions, the output doesn't depend on it
+        CompileCache* functionCache = nullptr; // reuses the code of functions that didn't change
+
+        struct FunctionSize {
+            std::string name;
+            size_t codeBytes;
+            size_t frameBytes; // locals and frame slots, before the 16 byte padding
+        };
+        std::vector<FunctionSize> functionSizes; // every function generated so far
+
+        struct ObjectStats {
+            size_t textBytes = 0;
+            size_t rodataBytes = 0;
+            size_t relocations = 0;
+            size_t symbols = 0;
+            size_t fileBytes = 0;
+        };
+        ObjectStats objectStats; // of the last object file written
 
         bool generateObjectFile(ProgramRoot* root, const std::string filename);
+        std::vector<uint8_t> generateText(ProgramRoot* root);
+        bool generateObjectFile(const FlatAST& ast, const std::string filename);
+        std::vector<uint8_t> generateText(const FlatAST& ast);
+        bool writeObjectFile(const std::vector<uint8_t>& textData, const std::string& filename);
 
     private:
         struct Variable {
@@ -67,24 +102,38 @@ class CodeGen {
                 bool isLocalArr;
                 bool isStruct;
                 size_t localArrSize;
+                bool inRegister = false; // promoted, no stack slot
+                Reg reg = Reg::RAX;
+
+                uint8_t typeSize; // of type, from the generator that made it
+                bool signedType; // char, short, int, long long
 
-                Variable(size_t offset, std::string type, size_t pointerCount, bool isLocalArr = false,
+                Variable(size_t offset, std::string type, uint8_t typeSize, size_t pointerCount, bool isLocalArr = false,
                 size_t localArrSize = 0, bool isStruct = false) :
                 offset(offset), type(type), pointerCount(pointerCount), isLocalArr(isLocalArr),
-                localArrSize(localArrSize), isStruct(isStruct) {};
+                localArrSize(localArrSize), isStruct(isStruct), typeSize(typeSize),
+                signedType(type == "char" || type == "short" || type == "int" || type == "long long") {};
+
+                bool isSigned() const { // of its value
+                    return signedType && pointerCount == 0 && !isLocalArr && !isStruct;
+                }
+
+                bool isElementSigned() const { // of what indexing it gives
+                    return signedType && pointerCount < 2;
+                }
 
                 uint8_t getSize() const {
                     if (pointerCount > 0) {
                         return 8;
                     }
-                    return typeSizes[type];
+                    return typeSize;
                 }
 
                 uint8_t getElementSize() const {
                     if (pointerCount >= 2) {
                         return 8;
                     }
-                    return typeSizes[type];
+                    return typeSize;
                 }
         };
 
@@ -92,83 +141,259 @@ class CodeGen {
         std::vector<Elf64_Rela> relaTextEntries;
         std::vector<Elf64_Rela> stringRelaEntries;
         std::vector<std::string> relaFuncStrings;
+        std::vector<uint32_t> stringRelaStrings; // pool index of each entry of stringRelaEntries
 
         std::vector<Symbol> functionSymbols;
         std::vector<Symbol> stringSymbols;
         std::vector<std::string> functionSymbolNames;
         std::unordered_map<std::string,bool> localFunctions;
 
-        std::string rodataContents;
+        std::vector<std::string> poolStrings; // distinct literals, in order of first use
+        std::unordered_map<std::string,uint32_t> stringIndices;
+        std::string rodataContents; // laid out from the pool when writing
+        std::string irDump; // --dump-ir text of the functions generated since the last print
 
         std::unordered_map<std::string,size_t> nameToSymbolOffset;
         std::vector<size_t> stringNumToSymbolOffset;
         size_t currentFunctionOffset = 0;
-        size_t currentStringsOffset = 0;
 
         std::unordered_map<std::string,Variable*> variableNameToObject;
         std::unordered_map<std::string,std::unordered_map<std::string,Variable*>*> structOffsets;
 
-        static std::unordered_map<std::string,uint8_t> typeSizes;
-        static std::unordered_map<uint8_t,std::string> positionToRegister;
-        static std::unordered_map<std::string,std::vector<uint8_t>> register64BitMov;
-        static std::unordered_map<std::string,std::vector<uint8_t>> register64BitLeaStub;
-        static std::unordered_map<std::string,std::vector<uint8_t>> movRegRaxMap;
-        static std::unordered_map<std::string,std::vector<uint8_t>> movRaxRegMap;
-        static std::unordered_map<std::string,std::vector<uint8_t>> pushRegCode;
-        static std::unordered_map<std::string,std::vector<uint8_t>> popRegCode;
-        static std::unordered_map<std::string,std::string> oppositeJumpType;
-        static std::unordered_map<std::string,std::vector<uint8_t>> jumpType;
+        static const std::unordered_map<std::string,uint8_t> builtinTypeSizes;
+        std::unordered_map<std::string,uint8_t> typeSizes = builtinTypeSizes; // and the structs seen so far
+        static constexpr Reg positionToRegister[6] = {Reg::RDI,Reg::RSI,Reg::RDX,Reg::RCX,Reg::R8,Reg::R9};
+
+        // expression temporaries, never argument registers, rax or rdx (used by div)
+        static constexpr Reg tempRegisters[7] = {Reg::R10,Reg::R11,Reg::RBX,Reg::R12,Reg::R13,Reg::R14,Reg::R15};
+        static constexpr uint32_t CALL_NEED = 16; // register need of any subtree with a call
+        uint16_t liveTemps = 0;
+        uint16_t usedCalleeSaved = 0;
+        uint16_t localRegs = 0; // taken by promoted locals for the whole function
+        uint16_t pendingTemps = 0; // allocated, value still being computed
+        uint8_t spilledTemps[16] = {};
+        uint32_t returnLabel = 0; // the shared epilogue
+
+        // labels and the branches to them, labels.cpp
+        struct Branch {
+            size_t location; // of the rel32 form
+            uint32_t label;
+            bool conditional;
+            Cond cond;
+            uint8_t size; // 6/5 (rel32), 2 (rel8) or 0 (falls through)
+        };
+        static constexpr size_t UNBOUND_LABEL = SIZE_MAX;
+        std::vector<size_t> labelOffsets;
+        std::vector<Branch> branches;
+        uint32_t newLabel();
+        void bindLabel(const std::vector<uint8_t>& code, uint32_t label);
+        void jmpTo(std::vector<uint8_t>& code, uint32_t label);
+        void jccTo(std::vector<uint8_t>& code, Cond cond, uint32_t label);
+        void resetLabels();
+        void resolveBranches(std::vector<uint8_t>& code, size_t relaStart, size_t stringRelaStart);
+
+        // frame slots below the locals, for saved registers and spills
+        size_t frameVarSizes = 0;
+        uint32_t frameSlots = 0;
+        size_t registerSlots[16] = {};
+        std::vector<size_t> spillSlots;
+        size_t spillDepth = 0;
+
+        struct LiveInterval {
+            size_t start;
+            size_t end;
+        };
+        static constexpr Reg localRegisters[5] = {Reg::RBX,Reg::R12,Reg::R13,Reg::R14,Reg::R15};
+        std::unordered_map<std::string,Reg> promotedLocals;
 
 
         // Functions
         void addCode(std::vector<uint8_t>& code, const std::vector<uint8_t>& codeToAdd);
-        void parseExpressionToReg(std::vector<uint8_t>& code, ASTNode* expression, std::string reg);
-        void parseComparsionExpressionCmp(std::vector<uint8_t>& code, ASTNode* expression);
-        void addConstantStringToRegToCode(std::vector<uint8_t>& code, const Constant* constant, const std::string& reg);
+        void addCode(std::vector<uint8_t>& code, std::initializer_list<uint8_t> codeToAdd); // fixed encodings, no temporary vector
+        int parseExpressionToReg(std::vector<uint8_t>& code, ASTNode* expression, Reg reg);
+        Cond parseComparsionExpressionCmp(std::vector<uint8_t>& code, ASTNode* expression);
+        int addCmpImmToCode(std::vector<uint8_t>& code, ASTNode* left, uint32_t num);
+        static bool isImmediate(const ASTNode* expression, uint32_t& num);
+        int expressionSign(const ASTNode* expression); // -1 signed, 1 unsigned, 0 only constants
+        static int combineSigns(int left, int right) { return (left > 0 || right > 0) ? 1 : std::min(left,right); }
+        void addConstantStringToRegToCode(std::vector<uint8_t>& code, const std::string& value, Reg reg);
+        uint32_t internString(const std::string& value);
+        void layoutStringPool();
         void addReturnStatementToCode(std::vector<uint8_t>& code, ReturnStatement* returnStatement);
         void addFunctionCallToCode(std::vector<uint8_t>& code, FunctionCall* functionCall);
         void addAssignmentToCode(std::vector<uint8_t>& code, Assignment* assignment);
         void addCodeBlockToCode(std::vector<uint8_t>& code, CodeBlock* codeBlock);
-        void addDeclarationsToCode(std::vector<uint8_t>& code, CodeBlock* codeBlock, std::vector<ASTNode*>& parameters);
+        size_t addDeclarationsToCode(std::vector<uint8_t>& code, CodeBlock* codeBlock, std::vector<ASTNode*>& parameters);
         void addIfStatementToCode(std::vector<uint8_t>& code, IfStatement* ifStatement);
         void addWhileStatementToCode(std::vector<uint8_t>& code, WhileStatement* whileStatement);
         size_t addDeclarations(const std::vector<ASTNode*>& parameters, size_t varSizes);
+        size_t addVariable(const std::string& name, const std::string& type, size_t pointerCount,
+        bool isLocalArray, size_t localArrSize, bool isStruct, size_t varSizes);
+        Variable* lookupVariable(const std::string& name);
+        const Variable* lookupField(const Variable* var, const std::string& property);
         void addStruct(Struct* structNode);
+        std::vector<uint8_t> generateFunction(Function* function);
+        std::vector<uint8_t> generateTextParallel(ProgramRoot* root);
+        void mergeFunction(std::vector<uint8_t>& textData, const CodeGen& worker, const std::vector<uint8_t>& code);
+        std::string functionFingerprint(const Function* function);
+        std::string saveFunction(const std::vector<uint8_t>& code) const;
+        bool loadFunction(const std::string& data, std::vector<uint8_t>& code);
         std::vector<uint8_t> generateCodeFromFunction(Function* function);
+        void addFunctionFrame(std::vector<uint8_t>& code, const std::string& name, size_t relaStart, size_t stringRelaStart);
+        void addFunctionSymbol(const std::string& name, size_t size);
+        MemOperand addElementOperand(std::vector<uint8_t>& code, ArrayAccess* arrAccess, Reg reg, bool acrossCall, Reg& temp);
+        MemOperand addPropertyOperand(std::vector<uint8_t>& code, PropertyAccess* propAccess, Reg reg, uint8_t& size);
+
+        // register allocation, registerAllocation.cpp
+        uint32_t registerNeed(const ASTNode* expression);
+        uint32_t numberRegisterNeed(const ASTNode* expression);
+        Reg allocateTemp(std::vector<uint8_t>& code, bool acrossCall, Reg avoid);
+        void releaseTemp(std::vector<uint8_t>& code, Reg reg);
+        int parseExpressionToTemp(std::vector<uint8_t>& code, ASTNode* expression, Reg temp);
+        int parseOperandsToRegs(std::vector<uint8_t>& code, ASTNode* left, ASTNode* right, Reg dst,
+        bool rightInTemp, Reg& leftReg, Reg& rightReg);
+        void addPrologue(std::vector<uint8_t>& code);
+        void addEpilogue(std::vector<uint8_t>& code);
+        size_t newFrameSlot();
+        size_t registerSlot(Reg reg);
+        void resetRegisterState(size_t varSizes);
+        void saveCallerSavedTemps(std::vector<uint8_t>& code, bool restore);
+        void allocateLocalRegisters(Function* function);
+        void collectLiveIntervals(ASTNode* node, size_t& position,
+        std::unordered_map<std::string,LiveInterval>& intervals, std::unordered_set<std::string>& addressTaken);
+
+        // SSA construction, irBuilder.cpp
+        struct IRBuildState {
+            IRFunction* function = nullptr;
+            uint32_t block = 0;
+            uint32_t undefined = UINT32_MAX;
+            std::vector<std::unordered_map<std::string,uint32_t>> definitions; // per block
+            std::vector<bool> sealed;
+            std::vector<std::vector<std::pair<std::string,uint32_t>>> incompletePhis;
+            std::vector<uint32_t> layout; // blocks in the order they were entered
+        };
+        IRBuildState ir;
+
+        IRFunction buildIRFunction(Function* function);
+        uint32_t irAdd(IROp op, std::vector<uint32_t> operands = {}, uint64_t imm = 0, uint8_t size = 8, bool isSigned = false);
+        uint32_t irNewBlock();
+        void irEnterBlock(uint32_t block);
+        void irAddEdge(uint32_t from, uint32_t to);
+        void irJump(uint32_t target);
+        void irSeal(uint32_t block);
+        bool irReachable(uint32_t block);
+        bool irTerminated();
+        void irWriteVariable(const std::string& name, uint32_t block, uint32_t value);
+        uint32_t irReadVariable(const std::string& name, uint32_t block);
+        uint32_t irAddPhi(uint32_t block);
+        void irAddPhiOperands(const std::string& name, uint32_t phi, uint32_t block);
+        uint32_t irUndefined();
+        void irRemoveTrivialPhis();
+        void irApplyLayout();
+        uint32_t irExpression(ASTNode* expression, int& sign);
+        uint32_t irExpression(ASTNode* expression) { int sign; return irExpression(expression,sign); }
+        std::vector<uint32_t> irAddress(ASTNode* target, uint8_t& size, uint64_t& disp);
+        void irCondition(ASTNode* expression, uint32_t trueBlock, uint32_t falseBlock);
+        void irCodeBlock(CodeBlock* codeBlock);
+
+        // IR lowering, irCodeGen.cpp
+        struct IRLocation {
+            // Stack: [rbp-offset], Address: rbp-offset itself, Immediate: offset as the imm32 of a cmp/add/sub/imul
+            enum Kind : uint8_t {Register, Stack, Address, Immediate} kind = Register;
+            Reg reg = Reg::RAX;
+            size_t offset = 0;
+            bool operator==(const IRLocation& other) const {
+                return kind == other.kind && (kind == Register ? reg == other.reg : offset == other.offset);
+            }
+        };
+        struct IRMove {
+            IRLocation dst;
+            IRLocation src;
+        };
+        static constexpr Reg irCallerSaved[6] = {Reg::RCX,Reg::RSI,Reg::RDI,Reg::R8,Reg::R9,Reg::R10};
+        std::vector<IRLocation> irLocations; // rax, rdx and r11 stay free as scratch
+
+        std::vector<uint8_t> generateCodeFromIR(const IRFunction& function);
+        void irAllocateRegisters(const IRFunction& function);
+        Reg irUse(std::vector<uint8_t>& code, uint32_t value, Reg scratch);
+        Reg irDefReg(uint32_t value);
+        MemOperand irMemOperand(std::vector<uint8_t>& code, const IRInstr& instr, size_t indexOperand);
+        void irDefine(std::vector<uint8_t>& code, uint32_t value, Reg reg);
+        void irMoveToCode(std::vector<uint8_t>& code, const IRLocation& dst, const IRLocation& src);
+        void irParallelMove(std::vector<uint8_t>& code, std::vector<IRMove> moves);
+
+        // FlatAST lowering, flatCodeGen.cpp
+        std::vector<uint8_t> generateCodeFromFlatFunction(const FlatAST& ast, uint32_t function);
+        size_t addFlatDeclarations(const FlatAST& ast, uint32_t listStart, uint32_t count, size_t varSizes);
+        void addFlatStruct(const FlatAST& ast, uint32_t structNode);
+        void addFlatCodeBlockToCode(std::vector<uint8_t>& code, const FlatAST& ast, uint32_t codeBlock);
+        int addFlatExpressionToCode(std::vector<uint8_t>& code, const FlatAST& ast, uint32_t expression); // its sign
+        uint8_t flatAccessSize(const FlatAST& ast, uint32_t target);
+        void flatPush(std::vector<uint8_t>& code, Reg reg);
+        void flatPop(std::vector<uint8_t>& code, Reg reg);
+        size_t flatPushed = 0; // values pushed meanwhile, an odd count misaligns the stack
+        Cond flatJumpCondition(FlatOp op, bool isSigned);
 
 
-        // Code translation functions
-        std::vector<uint8_t> exitSyscall(uint8_t num);
-        std::vector<uint8_t> call();
-        std::vector<uint8_t> movabs(const std::string& reg, uint64_t num);
-        std::vector<uint8_t> leaStub(const std::string& reg);
-        std::vector<uint8_t> pushReg(const std::string& reg);
-        std::vector<uint8_t> popReg(const std::string& reg);
-        std::vector<uint8_t> leave();
-        std::vector<uint8_t> leaveFunction();
-        std::vector<uint8_t> startFunction();
-        std::vector<uint8_t> ret();
-        std::vector<uint8_t> movRspRbp();
-        std::vector<uint8_t> movRaxOffsetRbp(uint32_t offset, uint8_t size);
-        std::vector<uint8_t> movOffsetRbpRax(uint32_t offset, uint8_t size);
-        std::vector<uint8_t> leaRaxOffsetRbp(uint32_t offset);
-        std::vector<uint8_t> subRsp(uint32_t num);
-        std::vector<uint8_t> movRegRax(const std::string& reg);
-        std::vector<uint8_t> movRaxReg(const std::string& reg);
-        std::vector<uint8_t> addRaxRbx();
-        std::vector<uint8_t> subRaxRbx();
-        std::vector<uint8_t> mulRbx(uint8_t size);
-        std::vector<uint8_t> divRbx(uint8_t size);
-        std::vector<uint8_t> cmpRaxRbx();
-        std::vector<uint8_t> jump(const std::string& type);
-        std::vector<uint8_t> oppositeJump(const std::string& type);
-        std::vector<uint8_t> movRaxQwordRax();
-        std::vector<uint8_t> movPtrRaxRbx(uint8_t size);
+        // Code translation functions, each appends to code
+        void call(std::vector<uint8_t>& code);
+        void movImm(std::vector<uint8_t>& code, Reg reg, uint64_t num); // shortest encoding of num
+        void leaRip(std::vector<uint8_t>& code, Reg reg);
+        void pushReg(std::vector<uint8_t>& code, Reg reg);
+        void popReg(std::vector<uint8_t>& code, Reg reg);
+        void leave(std::vector<uint8_t>& code);
+        void leaveFunction(std::vector<uint8_t>& code);
+        void startFunction(std::vector<uint8_t>& code);
+        void ret(std::vector<uint8_t>& code);
+        void movRegOffsetRbp(std::vector<uint8_t>& code, Reg reg, uint32_t offset, uint8_t size);
+        void movOffsetRbpReg(std::vector<uint8_t>& code, uint32_t offset, Reg reg, uint8_t size);
+        void leaRegOffsetRbp(std::vector<uint8_t>& code, Reg reg, uint32_t offset);
+        void subRsp(std::vector<uint8_t>& code, uint32_t num);
+        void movRegReg(std::vector<uint8_t>& code, Reg dst, Reg src);
+        void addRegReg(std::vector<uint8_t>& code, Reg dst, Reg src);
+        void subRegReg(std::vector<uint8_t>& code, Reg dst, Reg src);
+        void addRegImm(std::vector<uint8_t>& code, Reg reg, uint32_t num);
+        void subRegImm(std::vector<uint8_t>& code, Reg reg, uint32_t num);
+        void movzxRegReg(std::vector<uint8_t>& code, Reg dst, Reg src, uint8_t size);
+        void movsxRegReg(std::vector<uint8_t>& code, Reg dst, Reg src, uint8_t size);
+        void extendRegReg(std::vector<uint8_t>& code, Reg dst, Reg src, uint8_t size, bool isSigned);
+        void imulRegReg(std::vector<uint8_t>& code, Reg dst, Reg src);
+        void imulRegImm(std::vector<uint8_t>& code, Reg dst, Reg src, uint32_t num);
+        void shlRegImm(std::vector<uint8_t>& code, Reg reg, uint8_t count);
+        void shrRegImm(std::vector<uint8_t>& code, Reg reg, uint8_t count);
+        void andRegImm(std::vector<uint8_t>& code, Reg reg, uint64_t mask);
+        void divReg(std::vector<uint8_t>& code, Reg reg, uint8_t size);
+        void idivReg(std::vector<uint8_t>& code, Reg reg);
+        void cqo(std::vector<uint8_t>& code);
+        void cmpRegReg(std::vector<uint8_t>& code, Reg left, Reg right);
+        void cmpRegImm(std::vector<uint8_t>& code, Reg reg, uint32_t num);
+        void cmpOffsetRbpImm(std::vector<uint8_t>& code, uint32_t offset, uint32_t num, uint8_t size);
+        void testRegReg(std::vector<uint8_t>& code, Reg left, Reg right);
+        void jmp(std::vector<uint8_t>& code);
+        void jcc(std::vector<uint8_t>& code, Cond cond);
+        void movRegPtrReg(std::vector<uint8_t>& code, Reg dst, Reg base);
+        void movPtrRegReg(std::vector<uint8_t>& code, const MemOperand& mem, Reg src, uint8_t size);
+        void leaRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem);
+        void movzxRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem, uint8_t size);
+        void movsxRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem, uint8_t size);
+        void loadRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem, uint8_t size, bool isSigned);
 
+        // encoding helpers
+        void emitPrefixes(std::vector<uint8_t>& code, uint8_t size, bool regIsReg, Reg reg, bool rmIsReg, Reg rm, bool extendedIndex = false);
+        void emitRegReg(std::vector<uint8_t>& code, uint8_t opcode, Reg reg, Reg rm, uint8_t size);
+        void emitDigitReg(std::vector<uint8_t>& code, uint8_t opcode, uint8_t digit, Reg rm, uint8_t size);
+        void emitDigitRegImm(std::vector<uint8_t>& code, uint8_t digit, Reg rm, uint32_t num);
+        void emitRegMem(std::vector<uint8_t>& code, uint8_t opcode, Reg reg, const MemOperand& mem, uint8_t size);
+        void emitMemOperand(std::vector<uint8_t>& code, Reg reg, const MemOperand& mem);
+        static bool isIndexExtended(const MemOperand& mem);
+        Cond jumpCondition(const std::string& op, bool isSigned);
+        static bool fitsInt8(int64_t num);
+        static bool fitsInt32(uint64_t num);
 
         void addNumToCode(std::vector<uint8_t>& code, uint64_t num, uint8_t size);
         void changeJmpOffset(std::vector<uint8_t>& code, size_t codeOffset, uint32_t jmpSize);
         size_t getVarNodeSize(VariableDeclaration* node);
+        size_t getVarSize(const std::string& type, size_t pointerCount);
 
         // Macros
         // ELF symbol binding and type
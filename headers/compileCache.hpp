@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <mutex>
+#include <iostream>
+
+// on-disk cache of object files, addressed by a hash of everything that decides
+// their contents: the preprocessed source, the macros, the options and the
+// compiler build. entries are evicted least recently used first once the
+// directory grows past maxBytes. safe to share between the threads of a batch
+class CompileCache {
+    public:
+        CompileCache(const std::string& directory, uint64_t maxBytes);
+
+        static std::string key(const std::string& preprocessedCode,
+            const std::unordered_map<std::string,std::string>& macros, const std::string& options);
+
+        bool fetch(const std::string& key, const std::string& objectFile); // copies the entry on a hit
+        void store(const std::string& key, const std::string& objectFile);
+        // machine code of single functions, for recompiling a file whose objects missed.
+        // the fingerprint has to cover everything the function's code depends on
+        bool fetchFunction(const std::string& fingerprint, std::string& data);
+        void storeFunction(const std::string& fingerprint, const std::string& data);
+
+        void evict();     // oldest entries first until the cache fits in maxBytes
+        void saveStats(); // adds this run to the totals kept in the directory
+        void printStats(std::ostream& out);
+
+        struct Stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t stores = 0;
+            uint64_t evictions = 0;
+            uint64_t functionHits = 0;
+            uint64_t functionMisses = 0;
+        };
+
+    private:
+        std::string directory;
+        uint64_t maxBytes;
+        std::mutex mutex; // guards stats and evict
+        Stats stats;      // this run only
+
+        std::string entryPath(const std::string& key, const char* extension) const;
+        static std::string functionKey(const std::string& fingerprint);
+        Stats loadStats() const;
+};
\ No newline at end of file
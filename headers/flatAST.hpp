@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "ASTnode.hpp"
+#include "stringTable.hpp"
+
+enum class FlatOp : uint8_t {
+    None,
+    Add, Sub, Mul, Div, Mod,                                  // BinaryExpression
+    Shl, Shr, And,                                            // BinaryExpression by a constant
+    Equal, NotEqual, Greater, Less, GreaterEqual, LessEqual, // ComparisonExpression
+    AddressOf, Dereference,                                   // UnaryExpression
+};
+
+// structure-of-arrays encoding of the AST, nodes are referenced by index.
+// nodes are stored children first, so every subtree is the contiguous range
+// [subtreeStart[node], node]. binary operands are stored right then left,
+// the order the code generator evaluates them in
+class FlatAST {
+    public:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        // flags
+        static constexpr uint8_t STRING_CONSTANT = 1;
+        static constexpr uint8_t LOCAL_ARRAY = 2;
+        static constexpr uint8_t STRUCT = 4;
+        static constexpr uint8_t ADDRESS_ONLY = 8; // assignment target, don't load
+
+        std::vector<NodeType> kinds;
+        std::vector<FlatOp> ops;
+        std::vector<uint8_t> flags;
+        std::vector<uint32_t> first;        // first child, or start in lists
+        std::vector<uint32_t> second;       // second child, or length in lists
+        std::vector<uint32_t> third;        // third child, or declared type name
+        std::vector<uint32_t> text;         // name/string value in strings
+        std::vector<uint64_t> values;       // number constant / local array size
+        std::vector<uint32_t> subtreeStart;
+        std::vector<uint32_t> lists;        // statements, arguments, parameters, properties
+        StringTable strings;
+        uint32_t root = NONE;
+
+        void build(const ProgramRoot* programRoot);
+        void reserve(size_t nodes);
+        size_t size() const { return kinds.size(); }
+        size_t memoryBytes() const;
+
+        // FlatOp of an operator string of BinaryExpression/ComparisonExpression/UnaryExpression
+        static FlatOp opFromString(const std::string& op);
+
+    private:
+        uint32_t addNode(NodeType kind, uint32_t start);
+        uint32_t flatten(const ASTNode* node);
+        uint32_t flattenList(const std::vector<ASTNode*>& nodes, size_t maxCount = SIZE_MAX);
+};
\ No newline at end of file
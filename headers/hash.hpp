@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// 128 bit FNV-1a, kept as two 64 bit words since there is no portable 128 bit integer.
+// every add also mixes in the length, so "ab"+"c" and "a"+"bc" differ
+class Hash128 {
+    public:
+        void add(std::string_view bytes);
+        void add(uint64_t value);
+        std::string hex() const; // 32 digits
+
+    private:
+        uint64_t low = 0x62b821756295c58dULL; // the 128 bit offset basis
+        uint64_t high = 0x6c62272e07bb0142ULL;
+        void addByte(uint8_t byte);
+};
\ No newline at end of file
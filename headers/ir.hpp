@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iostream>
+#include "x86.hpp"
+
+enum class IROp : uint8_t {
+    Const,    // imm
+    String,   // address of the literal text in .rodata
+    Param,    // imm = argument position
+    Phi,      // one operand per predecessor, in predecessor order
+    Add, Sub, Mul, Div, Mod,
+    Shl, Shr, And, // operand 0 by imm
+    Truncate, // keep the low size bytes of operand 0
+    SlotAddr, // address of the stack slot at [rbp-imm]
+    Load,     // size bytes at operand 0 + imm, plus operand 1 * size if any
+    Store,    // size bytes of operand 1 to operand 0 + imm, plus operand 2 * size if any
+    Call,     // text = callee, operands = arguments
+    Jump,     // to succs[0]
+    Branch,   // operand 0 cond operand 1 ? succs[0] : succs[1]
+    Return,   // operand 0 if any
+};
+
+struct IRInstr {
+    IROp op;
+    uint8_t size = 8;
+    Cond cond = Cond::E;
+    bool isSigned = false; // Div/Mod: idiv, Truncate/Load: sign extended
+    bool removed = false; // dropped by a pass, still indexable
+    uint64_t imm = 0;
+    std::string text;
+    std::vector<uint32_t> operands;
+};
+
+struct IRBlock {
+    std::vector<uint32_t> instrs; // phis first, the terminator last
+    std::vector<uint32_t> preds;
+    std::vector<uint32_t> succs;
+};
+
+// SSA form of one function. every instruction defines the value of its index,
+// scalar locals whose address is never taken only exist as values.
+// blocks are laid out in index order, block 0 is the entry
+struct IRFunction {
+    std::string name;
+    std::vector<IRInstr> values;
+    std::vector<IRBlock> blocks;
+    size_t frameSize = 0; // bytes of stack slots
+
+    static bool hasResult(IROp op) { return op < IROp::Store || op == IROp::Call; }
+    static bool isTerminator(IROp op) { return op >= IROp::Jump; }
+    void print(std::ostream& out) const;
+};
\ No newline at end of file
@@ -1,24 +1,36 @@
 #pragma once
 #include <vector>
-#include <unordered_map>
 #include <string>
 #include "token.hpp"
+#include "stringTable.hpp"
 
 class Lexer {
     public:
-        Lexer(std::string& sourceCode) : sourceCode(sourceCode) {};
+        // the source buffer is owned by the caller and must outlive the lexer,
+        // token values are interned into strings
+        Lexer(const std::string& sourceCode, StringTable& strings) :
+        source(sourceCode.data()), sourceSize(sourceCode.size()), strings(strings) {};
+        Lexer(const char* source, size_t sourceSize, StringTable& strings) :
+        source(source), sourceSize(sourceSize), strings(strings) {};
         std::vector<Token> tokenize();
 
+        // zero-copy mode, tokens are (offset, length, type) views into the source buffer
+        std::vector<TokenView> tokenizeViews();
+        bool next(TokenView& token);
+        std::string tokenValue(const TokenView& token) const;
+
     private:
-        static std::unordered_map<std::string,tokenType> keywords;
-        static std::unordered_map<char,bool> symbols;
-        static std::unordered_map<char,char> escapeChars;
-        bool inString;
         size_t row;
         size_t column;
-        std::string sourceCode;
+        size_t tokenRow;    // position of the last token from next()
+        size_t tokenColumn;
+        size_t position = 0;
+        const char* source;
+        size_t sourceSize;
+        StringTable& strings;
 
-        Token createToken(const std::string& str);
-        bool isSymbol(const char chr);
-        bool isKeyword(const std::string& token);
+        char peek(size_t i) const { return i < sourceSize ? source[i] : '\0'; }
+        static tokenType classifyWord(const char* word, size_t length);
+        static tokenType classifySymbol(char chr, char nextChr, size_t& length);
+        static char escapeChar(char chr);
 };
\ No newline at end of file
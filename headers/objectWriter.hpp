@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// the pieces of a file in order, pointing into buffers that outlive the writer.
+// they go out with vectored writes instead of being copied together first
+class ObjectWriter {
+    public:
+        void add(const void* data, size_t size);
+        void padTo(uint64_t offset); // zeros up to offset, for alignment
+        uint64_t size() const { return totalSize; }
+        bool write(const std::string& filename) const;
+
+    private:
+        struct Piece {
+            const void* data;
+            size_t size;
+        };
+        std::vector<Piece> pieces;
+        uint64_t totalSize = 0;
+};
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include "ASTnode.hpp"
+#include "astArena.hpp"
+
+// AST to AST passes between the parser and the code generator (-O).
+// numbers are uint64_t like in the generated code, comparisons are unsigned.
+// variables of a signed type (char, short, int, long long) keep their divisions
+class Optimizer {
+    public:
+        Optimizer(ASTArena& arena) : arena(arena) {}
+
+        // folds constant subtrees, drops identities (x+0, x*1, x*0...),
+        // turns multiplication/division/modulo by powers of two into
+        // shifts and masks, and resolves conditions known at compile time
+        void fold(ProgramRoot* root);
+
+        // removes statements after a return, stores to locals that are never
+        // read before being overwritten (or never read at all), and the
+        // declarations of locals left without any use
+        void eliminateDeadCode(ProgramRoot* root);
+
+        struct DeadCodeStats {
+            std::string function;
+            size_t statements = 0;   // unreachable statements and dead stores
+            size_t declarations = 0; // locals that no longer get a stack slot
+        };
+        std::vector<DeadCodeStats> deadCodeStats; // one per function, filled by eliminateDeadCode
+
+    private:
+        ASTArena& arena; // new nodes live as long as the tree
+
+        // names in the function being folded whose value, or elements, are signed,
+        // and the signed fields as "struct.field"
+        std::unordered_set<std::string> signedValues;
+        std::unordered_set<std::string> signedElements;
+        std::unordered_map<std::string,std::string> structTypes;
+        std::unordered_set<std::string> signedFields;
+        void addSignedNames(const std::vector<ASTNode*>& declarations);
+        bool mayBeSigned(const ASTNode* expression) const;
+
+        void foldCodeBlock(CodeBlock* codeBlock);
+        ASTNode* foldExpression(ASTNode* expression);
+        ASTNode* foldBinary(BinaryExpression* binExpr);
+        ASTNode* multiply(ASTNode* left, uint64_t factor);
+        int knownCondition(ASTNode* expression); // 1 true, 0 false, -1 unknown
+
+        struct Uses {
+            std::unordered_map<std::string,size_t> reads;
+            std::unordered_map<std::string,size_t> writes;
+            std::unordered_set<std::string> addressTaken;
+        };
+        size_t removeUnreachable(CodeBlock* codeBlock);
+        size_t removeDeadStores(CodeBlock* codeBlock, const std::unordered_set<std::string>& locals, const Uses& uses);
+        static void collectUses(const ASTNode* node, Uses& uses);
+
+        static bool isNumber(const ASTNode* node, uint64_t& value);
+        static bool hasSideEffects(const ASTNode* expression);
+        static bool sameVariable(const ASTNode* left, const ASTNode* right);
+        static int powerOfTwo(uint64_t value); // the exponent, or -1
+        static bool isSignedType(const std::string& type);
+        Constant* makeNumber(uint64_t value);
+        BinaryExpression* makeBinary(ASTNode* left, const std::string& op, uint64_t right);
+};
\ No newline at end of file
@@ -1,26 +1,44 @@
 #pragma once
 #include <vector>
 #include <unordered_map>
+#include <stdexcept>
+#include <string>
 #include "ASTnode.hpp"
 #include "token.hpp"
+#include "stringTable.hpp"
+#include "astArena.hpp"
+
+// thrown on a syntax error, only the file being parsed fails
+struct ParseError : public std::runtime_error {
+    uint32_t row;
+    uint32_t column;
+    ParseError(uint32_t row, uint32_t column, const std::string& error) :
+    std::runtime_error(std::to_string(row) + ":" + std::to_string(column) + " " + error), row(row), column(column) {}
+};
 
 class Parser {
     public:
-        Parser(std::vector<Token> tokensList) : tokens(tokensList) {}
+        Parser(std::vector<Token>&& tokensList, const StringTable& strings, ASTArena& arena) :
+        tokens(std::move(tokensList)), strings(strings), arena(arena) {}
         ProgramRoot* Parser::parse();
 
     private:
         std::vector<Token> tokens;
+        const StringTable& strings;
+        ASTArena& arena; // owns every node of the returned tree
+        static const Token endOfFile;
         std::unordered_map<std::string,bool> structNames;
         size_t index = 0;
-        Token current();
+        const Token& current() const;
         void advance();
         void back();
-        Token peekNext();
+        const Token& peekNext() const;
+        const std::string& value(const Token& token) const { return strings.get(token.valueIndex); }
         void require(const tokenType type, const std::string& name);
         void parserError(const std::string& error);
         ASTNode* parseStatement();
         ASTNode* parseFunction();
+        void fingerprintFunction(Function* function, size_t firstToken);
         CodeBlock* parseCodeBlock();
         ASTNode* parseExpression();
         bool shouldExpressionContinue();
@@ -6,6 +6,7 @@
 class Preprocessor {
     public:
         std::string preProcess(std::ifstream& fileStream);
+        const std::unordered_map<std::string,std::string>& definedMacros() const { return macros; }
 
     private:
         bool inString;
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+// interned identifiers and literals of one translation unit, index 0 is ""
+class StringTable {
+    public:
+        StringTable() { intern(""); }
+        uint32_t intern(std::string_view str);
+        const std::string& get(uint32_t index) const { return strings[index]; }
+        size_t size() const { return strings.size(); }
+
+    private:
+        std::deque<std::string> strings; // deque so the keys below stay valid
+        std::unordered_map<std::string_view,uint32_t> indices;
+};
\ No newline at end of file
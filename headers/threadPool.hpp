@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+// fixed set of threads, each with its own task deque. a thread takes from the
+// back of its own deque and steals from the front of the others when it runs dry
+class ThreadPool {
+    public:
+        ThreadPool(unsigned threadCount);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void submit(std::function<void()> task); // round robin over the deques
+        void wait();                             // until every submitted task has finished
+
+    private:
+        struct TaskQueue {
+            std::deque<std::function<void()>> tasks;
+            std::mutex mutex;
+        };
+        std::vector<std::unique_ptr<TaskQueue>> queues;
+        std::vector<std::thread> threads;
+        size_t nextQueue = 0;
+
+        std::mutex stateMutex;
+        std::condition_variable taskAdded;
+        std::condition_variable allDone;
+        size_t queued = 0;  // in a deque
+        size_t pending = 0; // queued or running
+        bool stopping = false;
+
+        bool takeTask(size_t self, std::function<void()>& task);
+        void run(size_t self);
+};
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// wall time, heap allocations and peak heap of each stage of one compilation,
+// and counters of what it produced (--time-report, --stats). allocations are
+// counted per thread once countAllocations was called, worker threads count
+// into the thread they work for, as the -j codegen threads do
+class TimeReport {
+    public:
+        TimeReport(const std::string& filename) : filename(filename) {}
+
+        void start(const std::string& stage); // ends the running stage, if any
+        void stop();
+        void count(const std::string& counter, uint64_t value);
+
+        void print(std::ostream& out, bool stages, bool counters) const;
+        void printJSON(std::ostream& out, bool stages, bool counters) const;
+        static size_t peakRSSKilobytes(); // of the whole process
+
+        struct AllocationCounters;
+        static void countAllocations();
+        static AllocationCounters* threadAllocationCounters(); // where the calling thread counts
+        static void countAllocationsInto(AllocationCounters* counters); // for the calling thread
+
+    private:
+        struct Stage {
+            std::string name;
+            double seconds = 0;
+            uint64_t allocations = 0;
+            uint64_t allocatedBytes = 0;
+            int64_t peakHeapBytes = 0; // most live heap during the stage, above where it started
+        };
+        std::string filename;
+        std::vector<Stage> stages;
+        std::vector<std::pair<std::string,uint64_t>> counters;
+        bool running = false;
+        std::chrono::steady_clock::time_point startTime;
+        uint64_t startAllocations = 0;
+        uint64_t startAllocatedBytes = 0;
+        int64_t startLiveBytes = 0;
+};
\ No newline at end of file
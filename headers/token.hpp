@@ -1,8 +1,10 @@
 #pragma once
 #include <string>
 #include <iostream>
+#include <cstdint>
+#include "stringTable.hpp"
 
-enum tokenType {
+enum tokenType : uint8_t {
     RETURN,
     CONSTANT,
     SEMICOLON,
@@ -24,17 +26,26 @@ enum tokenType {
     ENDOFFILE
 };
 
+struct TokenView {
+    uint32_t offset; // offset in the source buffer
+    uint32_t length;
+    tokenType type;
+};
+
 struct Token {
 public:
 
+    uint32_t offset;     // offset in the source buffer
+    uint32_t valueIndex; // index in the StringTable
+    uint32_t row;
+    uint16_t column;     // saturates on very long lines
     tokenType type;
-    size_t row;
-    size_t column;
-    std::string value;
 
-    void print() const {
-        std::cout << row << ":" << column << " Type: " << type << " Val: " << value;
+    void print(const StringTable& strings) const {
+        std::cout << row << ":" << column << " Type: " << (int)type << " Val: " << strings.get(valueIndex);
     }
-    Token(tokenType t, const std::string& v, size_t row, size_t column) :
-    type(t), value(v), row(row), column(column) {}
-};
\ No newline at end of file
+    Token(tokenType t, uint32_t valueIndex, size_t row, size_t column, size_t offset = 0) :
+    offset(offset), valueIndex(valueIndex), row(row), column(column > UINT16_MAX ? UINT16_MAX : column), type(t) {}
+};
+
+static_assert(sizeof(Token) <= 16, "keep tokens packed");
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+
+// x86-64 register numbers as used in ModRM/REX encoding
+enum class Reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+// condition codes, the low nibble of jcc/setcc opcodes.
+// flipping the lowest bit gives the opposite condition
+enum class Cond : uint8_t {
+    B  = 0x2, // below (unsigned <)
+    AE = 0x3, // above or equal (unsigned >=)
+    E  = 0x4, // equal
+    NE = 0x5, // not equal
+    BE = 0x6, // below or equal (unsigned <=)
+    A  = 0x7, // above (unsigned >)
+    L  = 0xC, // less (signed <)
+    GE = 0xD, // greater or equal (signed >=)
+    LE = 0xE, // less or equal (signed <=)
+    G  = 0xF, // greater (signed >)
+};
+
+// a memory operand [base+index*scale+disp], scale 0 means there is no index
+struct MemOperand {
+    Reg base;
+    int32_t disp = 0;
+    Reg index = Reg::RSP; // rsp can not be an index, the SIB encoding of none
+    uint8_t scale = 0;
+};
+
+constexpr uint8_t regCode(Reg reg) { return (uint8_t)reg & 7; }
+constexpr bool isExtendedReg(Reg reg) { return (uint8_t)reg >= 8; }
+constexpr uint16_t regBit(Reg reg) { return (uint16_t)(1 << (uint8_t)reg); }
+
+// registers a callee has to preserve besides rbp/rsp (System V)
+constexpr bool isCalleeSaved(Reg reg) { return reg == Reg::RBX || (uint8_t)reg >= (uint8_t)Reg::R12; }
+
+constexpr uint8_t modRM(uint8_t mod, uint8_t reg, uint8_t rm) {
+    return (uint8_t)((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+constexpr uint8_t sib(uint8_t scale, uint8_t index, uint8_t base) {
+    return (uint8_t)((scale << 6) | ((index & 7) << 3) | (base & 7));
+}
+
+// REX prefix with W (64 bit operand), R (extends ModRM.reg), X (extends SIB.index), B (extends ModRM.rm/base)
+constexpr uint8_t rex(bool w, bool r, bool x, bool b) {
+    return (uint8_t)(0x40 | (w << 3) | (r << 2) | (x << 1) | (uint8_t)b);
+}
+
+constexpr Cond oppositeCond(Cond cond) { return (Cond)((uint8_t)cond ^ 1); }
+
+// the condition that holds with the operands of the cmp swapped
+constexpr Cond swappedCond(Cond cond) {
+    if (cond == Cond::E || cond == Cond::NE) {
+        return cond;
+    }
+    return (Cond)((uint8_t)cond < 8 ? 9 - (uint8_t)cond : 0x1B - (uint8_t)cond);
+}
+
+static_assert(modRM(3, regCode(Reg::RAX), regCode(Reg::RBX)) == 0xC3, "mov rbx, rax");
+static_assert(rex(true, false, false, isExtendedReg(Reg::R9)) == 0x49, "REX.WB");
+static_assert(oppositeCond(Cond::E) == Cond::NE && oppositeCond(Cond::A) == Cond::BE, "jcc inversion");
+static_assert(swappedCond(Cond::B) == Cond::A && swappedCond(Cond::GE) == Cond::LE, "cmp operand swap");
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <algorithm>
+#include "astArena.hpp"
+
+void* ASTArena::allocate(size_t size, size_t alignment) {
+    uintptr_t address = (uintptr_t)current;
+    uintptr_t aligned = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (current == nullptr || aligned + size > (uintptr_t)end) { // new block
+        size_t newBlockSize = std::max(blockSize, size + alignment);
+        char* block = new char[newBlockSize];
+        blocks.push_back(block);
+        reservedBytes += newBlockSize;
+        current = block;
+        end = block + newBlockSize;
+        address = (uintptr_t)current;
+        aligned = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+    current = (char*)(aligned + size);
+    usedBytes += size;
+    return (void*)aligned;
+}
+
+void ASTArena::release() {
+    for (size_t i = nodes.size(); i > 0; --i) {
+        nodes[i-1]->~ASTNode();
+    }
+    for (char* block : blocks) {
+        delete[] block;
+    }
+    nodes.clear();
+    blocks.clear();
+    current = nullptr;
+    end = nullptr;
+    usedBytes = 0;
+    reservedBytes = 0;
+    std::fill(nodeCount, nodeCount + NODE_TYPE_COUNT, 0);
+    std::fill(nodeBytes, nodeBytes + NODE_TYPE_COUNT, 0);
+}
+
+static const char* nodeTypeNames[NODE_TYPE_COUNT] = {
+    "ReturnStatement",
+    "Constant",
+    "Expression",
+    "BinaryExpression",
+    "Statement",
+    "CodeBlock",
+    "Function",
+    "ProgramRoot",
+    "Operation",
+    "FunctionCall",
+    "VariableDeclaration",
+    "Identifier",
+    "UnaryExpression",
+    "Assignment",
+    "ComparisonExpression",
+    "IfStatement",
+    "WhileStatement",
+    "ArrayAccess",
+    "Struct",
+    "PropertyAccess",
+};
+
+void ASTArena::printStats(std::ostream& out) const {
+    out << "AST arena: " << nodes.size() << " nodes, " << usedBytes << " bytes used, "
+    << reservedBytes << " bytes reserved in " << blocks.size() << " blocks\n";
+    for (size_t i = 0; i < NODE_TYPE_COUNT; ++i) {
+        if (nodeCount[i] == 0) {
+            continue;
+        }
+        out << "  " << nodeTypeNames[i] << ": " << nodeCount[i] << " nodes, " << nodeBytes[i] << " bytes\n";
+    }
+}
\ No newline at end of file
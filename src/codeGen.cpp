@@ -1,25 +1,54 @@
 #include <unordered_map>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <stdexcept>
 #include "ASTnode.hpp"
 #include "CodeGen.hpp"
+#include "objectWriter.hpp"
 
 
 bool CodeGen::generateObjectFile(ProgramRoot* root, const std::string filename) {
+    return writeObjectFile(generateText(root),filename);
+}
 
-    // .text section ------------------------------------------------------------
+// .text of every function, also fills the symbols, relocations and .rodata
+std::vector<uint8_t> CodeGen::generateText(ProgramRoot* root) {
+    if (jobs > 1 || functionCache != nullptr) {
+        return generateTextParallel(root);
+    }
     std::vector<uint8_t> textData;
     for (const ASTNode* element : root->programElements) {
         if (element->type == NodeType::Function) {
-            std::vector<uint8_t> functionCode = generateCodeFromFunction((Function*)element);
+            std::vector<uint8_t> functionCode = generateFunction((Function*)element);
             addCode(textData,functionCode);
+            std::cout << irDump;
+            irDump.clear();
         }
         if (element->type == NodeType::Struct) {
             addStruct((Struct*)element);
         }
     }
+    return textData;
+}
+
+std::vector<uint8_t> CodeGen::generateFunction(Function* function) {
+    if (!useIR) {
+        return generateCodeFromFunction(function);
+    }
+    IRFunction irFunction = buildIRFunction(function);
+    if (dumpIR && (dumpIRFunction.empty() || dumpIRFunction == irFunction.name)) {
+        std::ostringstream out;
+        irFunction.print(out);
+        irDump += out.str();
+    }
+    return generateCodeFromIR(irFunction);
+}
+
+bool CodeGen::writeObjectFile(const std::vector<uint8_t>& textData, const std::string& filename) {
     // take care of non-local functions
     {
         std::unordered_map<std::string,bool> finished;
@@ -68,6 +97,7 @@ bool CodeGen::generateObjectFile(ProgramRoot* root, const std::string filename)
     }
 
     // add a name for each string symbol
+    layoutStringPool();
     for (size_t i = 0; i < stringSymbols.size(); ++i) {
         size_t offset = strtabContents.size();
         std::string stringName = "string" + std::to_string(i);
@@ -188,21 +218,13 @@ bool CodeGen::generateObjectFile(ProgramRoot* root, const std::string filename)
     }
 
     for (size_t i = 0; i < relaTextEntries.size(); ++i ) {
-
-        if (localFunctions.find(relaFuncStrings[i]) != localFunctions.end()) { // local function
-            uint32_t symIndex = nameToSymbolOffset[relaFuncStrings[i]];
-            relaTextEntries[i].r_info = ELF64_R_INFO(symIndex,R_X86_64_PC32);
-            // symbol index and R_X86_64_PC32 (2)
-        }
-        else { // library function
-            uint32_t symIndex = nameToSymbolOffset[relaFuncStrings[i]];
-            relaTextEntries[i].r_info = ELF64_R_INFO(symIndex,R_X86_64_PLT32);
-            // no symbol index, PLT linking symbol
-        }
+        // PLT32 for local functions too, they are global symbols a shared library may interpose
+        uint32_t symIndex = nameToSymbolOffset[relaFuncStrings[i]];
+        relaTextEntries[i].r_info = ELF64_R_INFO(symIndex,R_X86_64_PLT32);
     }
     for (size_t i = 0; i < stringRelaEntries.size(); ++i) {
-        uint32_t symIndex = stringNumToSymbolOffset[i];
-        stringRelaEntries[i].r_info = ELF64_R_INFO(symIndex,1);
+        uint32_t symIndex = stringNumToSymbolOffset[stringRelaStrings[i]];
+        stringRelaEntries[i].r_info = ELF64_R_INFO(symIndex,R_X86_64_PC32);
     }
 
 
@@ -324,9 +346,10 @@ bool CodeGen::generateObjectFile(ProgramRoot* root, const std::string filename)
         SectionHeader &sh = shdr[8];
         sh.sh_name      = offRoData;
         sh.sh_type      = 1; // SHT_PROGBITS (contains data)
-        sh.sh_flags     = 0x02; // A (loaded into memory)           
+        sh.sh_flags     = 0x02 | 0x10 | 0x20; // A (loaded into memory), merge, strings: the linker dedupes them further
         sh.sh_size      = rodataContents.size();
         sh.sh_addralign = 1;
+        sh.sh_entsize   = 1; // chars
     }
     // remember to add +1 to numSections when adding new section, and change shdr[i]
 
@@ -374,131 +397,97 @@ bool CodeGen::generateObjectFile(ProgramRoot* root, const std::string filename)
     shdr[8].sh_offset = offset;
     offset += shdr[8].sh_size;
 
-    // 7) write elf file
-    std::ofstream ofs(filename, std::ios::binary);
-    if (!ofs) return false;
-
-    // ELF header
-    ofs.write(reinterpret_cast<const char*>(&ehdr), sizeof(ehdr));
-    // Section headers
-    ofs.write(reinterpret_cast<const char*>(shdr.data()), shdr.size() * sizeof(SectionHeader));
-    // .text
-    ofs.write(reinterpret_cast<const char*>(textData.data()), textData.size());
-    // .data
-    ofs.write(reinterpret_cast<const char*>(dataData.data()), dataData.size());
+    // 7) write elf file, the layout above is final so every piece goes out from where it already is
+    ObjectWriter writer;
+    writer.add(&ehdr,sizeof(ehdr));
+    writer.add(shdr.data(),shdr.size() * sizeof(SectionHeader));
+    writer.add(textData.data(),textData.size());
+    writer.add(dataData.data(),dataData.size());
     // .bss => SHT_NOBITS => nothing to write
-    // pad if needed for alignment to .symtab
-    {
-        uint64_t currentPos = ofs.tellp();
-        uint64_t neededPad = (8 - (currentPos % 8)) % 8;
-        if (neededPad) {
-            std::vector<char> pad(neededPad, 0);
-            ofs.write(pad.data(), pad.size());
-        }
+    writer.padTo(shdr[4].sh_offset);
+    writer.add(symtabRaw,symtabSizeInBytes);
+    writer.add(strtabContents.data(),strtabContents.size());
+    writer.padTo(shdr[6].sh_offset);
+    writer.add(relaTextEntries.data(),relaTextEntries.size() * sizeof(Elf64_Rela));
+    writer.add(stringRelaEntries.data(),stringRelaEntries.size() * sizeof(Elf64_Rela));
+    writer.add(shstrtabContents.data(),shstrtabContents.size());
+    writer.add(rodataContents.data(),rodataContents.size());
+    if (writer.size() != offset || !writer.write(filename)) {
+        return false;
     }
-    // .symtab
-    ofs.write(reinterpret_cast<const char*>(symtabRaw), symtabSizeInBytes);
-    // .strtab
-    ofs.write(strtabContents.data(), strtabContents.size());
-    // .rela.text
-    {
-        // pad if needed
-        uint64_t currentPos = ofs.tellp();
-        uint64_t neededPad = (8 - (currentPos % 8)) % 8;
-        if (neededPad) {
-            std::vector<char> pad(neededPad, 0);
-            ofs.write(pad.data(), pad.size());
-        }
-        for (auto &rel : relaTextEntries) {
-            ofs.write(reinterpret_cast<const char*>(&rel), sizeof(rel));
-        }
-        for (auto &rel : stringRelaEntries) {
-            ofs.write(reinterpret_cast<const char*>(&rel), sizeof(rel));
-        }
-    }
-    // .shstrtab
-    ofs.write(shstrtabContents.data(), shstrtabContents.size());
-
-    // .rodata
-    ofs.write(rodataContents.data(), rodataContents.size());
 
-    ofs.close();
+    objectStats.textBytes = textData.size();
+    objectStats.rodataBytes = rodataContents.size();
+    objectStats.relocations = relaTextEntries.size() + stringRelaEntries.size();
+    objectStats.symbols = symtab.size();
+    objectStats.fileBytes = writer.size();
     return true;
 }
 
-void CodeGen::parseExpressionToReg(std::vector<uint8_t>& code, ASTNode* expression, std::string reg) {
+// returns the sign of the value, as expressionSign would give it
+int CodeGen::parseExpressionToReg(std::vector<uint8_t>& code, ASTNode* expression, Reg reg) {
     if (expression->type == NodeType::Constant) {
         Constant* constant = (Constant*)expression;
         if (constant->constantType == "uint64_t") {
             uint64_t value = std::stoll(constant->value);
-            addCode(code,movabs(reg,value));
+            movImm(code,reg,value);
         }
         else if (constant->constantType == "string") {
-            addConstantStringToRegToCode(code,constant,reg);
+            addConstantStringToRegToCode(code,constant->value,reg);
+            return 1;
         }
-        return;
+        return 0;
     }
 
     if (expression->type == NodeType::Identifier) {
         Identifier* identifier = (Identifier*)expression;
-        const Variable* var = variableNameToObject[identifier->name];
-        if (var->isLocalArr || var->isStruct) {
-            addCode(code,leaRaxOffsetRbp(var->offset));
+        const Variable* var = lookupVariable(identifier->name);
+        if (var->inRegister) {
+            movRegReg(code,reg,var->reg);
         }
-        else {
-            addCode(code,movRaxOffsetRbp(var->offset,var->getSize()));
+        else if (var->isLocalArr || var->isStruct) {
+            leaRegOffsetRbp(code,reg,var->offset);
         }
-        if (reg != "rax") {
-            addCode(code,movRegRax(reg));
+        else {
+            loadRegMem(code,reg,{Reg::RBP,-(int32_t)var->offset},var->getSize(),var->isSigned());
         }
-        return;
+        return var->isSigned() ? -1 : 1;
     }
 
     if (expression->type == NodeType::ArrayAccess) {
         ArrayAccess* arrAccess = (ArrayAccess*)expression;
         // only identifier for now
         if (arrAccess->array->type == NodeType::Identifier) {
-            Identifier* identifier = (Identifier*)arrAccess->array;
-            const Variable* var = variableNameToObject[identifier->name];
-            parseExpressionToReg(code,arrAccess->index,"rax");
-            addCode(code,movabs("rbx",var->getElementSize()));
-            addCode(code,mulRbx(8));
-            addCode(code,movRegRax("rbx"));
-            parseExpressionToReg(code,identifier,"rax");
-            addCode(code,addRaxRbx());
-            addCode(code,movRaxQwordRax());
-            if (reg != "rax") {
-                addCode(code,movRegRax(reg));
+            const Variable* var = lookupVariable(((Identifier*)arrAccess->array)->name);
+            Reg temp;
+            MemOperand element = addElementOperand(code,arrAccess,reg,false,temp);
+            loadRegMem(code,reg,element,var->getElementSize(),var->isElementSigned());
+            if (temp != Reg::RSP) {
+                releaseTemp(code,temp);
             }
+            return var->isElementSigned() ? -1 : 1;
         }
     }
 
     if (expression->type == NodeType::PropertyAccess) {
-        PropertyAccess* arrAccess = (PropertyAccess*)expression;
+        PropertyAccess* propAccess = (PropertyAccess*)expression;
         // only identifier for now
-        if (arrAccess->Struct->type == NodeType::Identifier) {
-            Identifier* identifier = (Identifier*)arrAccess->Struct;
-            const Variable* var = variableNameToObject[identifier->name];
-            const Variable* structVar = (*structOffsets[var->type])[arrAccess->property];
-            parseExpressionToReg(code,identifier,"rax");
-            if (structVar->offset > 0) { // optimization, skipping adding 0
-                addCode(code,movabs("rbx",structVar->offset));
-                addCode(code,addRaxRbx());
-            }
-            addCode(code,movRaxQwordRax());
-            if (reg != "rax") {
-                addCode(code,movRegRax(reg));
-            }
+        if (propAccess->Struct->type == NodeType::Identifier) {
+            uint8_t size;
+            MemOperand field = addPropertyOperand(code,propAccess,reg,size);
+            int sign = expressionSign(propAccess);
+            loadRegMem(code,reg,field,size,sign < 0);
+            return sign;
         }
     }
 
     if (expression->type == NodeType::FunctionCall) {
         FunctionCall* functionCall = (FunctionCall*)expression;
         addFunctionCallToCode(code,functionCall); // returns in rax
-        if (reg != "rax") {
-            addCode(code,movRegRax(reg));
+        if (reg != Reg::RAX) {
+            movRegReg(code,reg,Reg::RAX);
         }
-        return;
+        return 0;
     }
 
     if (expression->type == NodeType::UnaryExpression) {
@@ -506,103 +495,270 @@ void CodeGen::parseExpressionToReg(std::vector<uint8_t>& code, ASTNode* expressi
         if (unaryExpr->op == "&") {
             if (unaryExpr->expression->type == NodeType::Identifier) {
                 Identifier* identifier = (Identifier*)unaryExpr->expression;
-                const Variable* var = variableNameToObject[identifier->name];
-                addCode(code,leaRaxOffsetRbp(var->offset));
-                if (reg != "rax") {
-                    addCode(code,movRegRax(reg));
-                }
+                const Variable* var = lookupVariable(identifier->name);
+                leaRegOffsetRbp(code,reg,var->offset);
             }
         }
 
         if (unaryExpr->op == "*") {
-            parseExpressionToReg(code,unaryExpr->expression,"rax");
-            addCode(code,movRaxQwordRax());
+            parseExpressionToReg(code,unaryExpr->expression,reg);
+            uint8_t size = 8;
+            if (unaryExpr->expression->type == NodeType::Identifier) {
+                const Variable* var = lookupVariable(((Identifier*)unaryExpr->expression)->name);
+                size = var->getElementSize();
+            }
+            int sign = expressionSign(unaryExpr);
+            loadRegMem(code,reg,{reg},size,sign < 0);
+            return sign;
         }
-        return;
+        return 1; // an address
     }
     if (expression->type == NodeType::BinaryExpression) {
         BinaryExpression* binExpr = (BinaryExpression*)expression;
-        ASTNode* left = binExpr->left;
-        ASTNode* right = binExpr->right;
-        parseExpressionToReg(code,right,"rax");
-        addCode(code,pushReg("rax"));
-        parseExpressionToReg(code,left,"rax");
-        addCode(code,popReg("rbx"));
         const std::string& op = binExpr->op;
+        if (op == "<<" || op == ">>" || op == "&") { // only made by the optimizer, the right side is a constant
+            int sign = parseExpressionToReg(code,binExpr->left,reg);
+            uint64_t num = std::stoull(((Constant*)binExpr->right)->value);
+            if (op == "<<") {
+                shlRegImm(code,reg,num);
+            }
+            else if (op == ">>") {
+                shrRegImm(code,reg,num);
+            }
+            else {
+                andRegImm(code,reg,num);
+            }
+            return sign;
+        }
+        uint32_t num;
+        if (op == "*" && (isImmediate(binExpr->right,num) || isImmediate(binExpr->left,num))) {
+            int sign = parseExpressionToReg(code,isImmediate(binExpr->right,num) ? binExpr->left : binExpr->right,reg);
+            imulRegImm(code,reg,reg,num);
+            return sign;
+        }
+        bool isDivision = (op == "/" || op == "%");
+        Reg leftReg, rightReg;
+        int sign = parseOperandsToRegs(code,binExpr->left,binExpr->right,reg,isDivision,leftReg,rightReg);
+        Reg temp = (leftReg == reg) ? rightReg : leftReg;
         if (op == "+") {
-            addCode(code,addRaxRbx());
+            addRegReg(code,reg,temp);
         }
         if (op == "-") {
-            addCode(code,subRaxRbx());
+            if (leftReg == reg) {
+                subRegReg(code,reg,temp);
+            }
+            else {
+                subRegReg(code,temp,reg);
+                movRegReg(code,reg,temp);
+            }
         }
         if (op == "*") {
-            addCode(code,mulRbx(8));
+            imulRegReg(code,reg,temp);
+        }
+        if (isDivision) { // the left operand is in reg, the divisor in temp
+            if (reg != Reg::RAX) {
+                movRegReg(code,Reg::RAX,reg);
+            }
+            if (sign < 0) {
+                cqo(code);
+                idivReg(code,temp);
+            }
+            else {
+                movImm(code,Reg::RDX,0);
+                divReg(code,temp,8);
+            }
+            Reg result = (op == "/") ? Reg::RAX : Reg::RDX;
+            if (reg != result) {
+                movRegReg(code,reg,result);
+            }
+        }
+        releaseTemp(code,temp);
+        return sign;
+    }
+    return 0;
+}
+
+// the element as [base+index*scale+disp], using reg for the index or the base.
+// a pointer in the frame indexed by a computed value also needs a temp for
+// the base, it is returned in temp for the caller to release (rsp when there is none)
+MemOperand CodeGen::addElementOperand(std::vector<uint8_t>& code, ArrayAccess* arrAccess, Reg reg, bool acrossCall, Reg& temp) {
+    Identifier* identifier = (Identifier*)arrAccess->array;
+    const Variable* var = lookupVariable(identifier->name);
+    uint8_t sizeOfElement = var->getElementSize();
+    MemOperand element{reg};
+    temp = Reg::RSP;
+    uint32_t num;
+    if (isImmediate(arrAccess->index,num) && fitsInt32((uint64_t)num * sizeOfElement)) { // constant index, only a displacement
+        element.disp = (int32_t)(num * sizeOfElement);
+    }
+    else {
+        Reg index = reg;
+        const Variable* indexVar = nullptr;
+        if (arrAccess->index->type == NodeType::Identifier) {
+            indexVar = lookupVariable(((Identifier*)arrAccess->index)->name);
         }
-        if (op == "/") {
-            addCode(code,movabs("rdx",0));
-            addCode(code,divRbx(8));
+        if (indexVar != nullptr && indexVar->inRegister) { // used in place
+            index = indexVar->reg;
         }
-        if (op == "%") {
-            addCode(code,movabs("rdx",0));
-            addCode(code,divRbx(8));
-            addCode(code,movRaxReg("rdx"));
+        else {
+            parseExpressionToReg(code,arrAccess->index,reg);
         }
-        if (reg != "rax") {
-            addCode(code,movRegRax(reg));
+        if (sizeOfElement == 1 || sizeOfElement == 2 || sizeOfElement == 4 || sizeOfElement == 8) {
+            element.index = index;
+            element.scale = sizeOfElement;
         }
-        return;
+        else { // no such scale
+            imulRegImm(code,reg,index,sizeOfElement);
+            element.index = reg;
+            element.scale = 1;
+        }
+    }
+
+    if (var->inRegister) {
+        element.base = var->reg;
+    }
+    else if (var->isLocalArr) {
+        element.base = Reg::RBP;
+        element.disp -= (int32_t)var->offset;
+    }
+    else {
+        if (element.index == reg) {
+            temp = allocateTemp(code,acrossCall,reg);
+            element.base = temp;
+        }
+        movRegOffsetRbp(code,element.base,var->offset,8);
     }
+    return element;
+}
 
+// the field as [base+disp], structs in the frame are addressed from rbp, pointers from reg
+MemOperand CodeGen::addPropertyOperand(std::vector<uint8_t>& code, PropertyAccess* propAccess, Reg reg, uint8_t& size) {
+    Identifier* identifier = (Identifier*)propAccess->Struct;
+    const Variable* var = lookupVariable(identifier->name);
+    const Variable* structVar = lookupField(var,propAccess->property);
+    size = structVar->getSize();
+    if (var->inRegister) {
+        return {var->reg,(int32_t)structVar->offset};
+    }
+    if (var->isStruct) {
+        return {Reg::RBP,(int32_t)structVar->offset - (int32_t)var->offset};
+    }
+    parseExpressionToReg(code,identifier,reg);
+    return {reg,(int32_t)structVar->offset};
 }
 
-void CodeGen::addConstantStringToRegToCode(std::vector<uint8_t>& code,const Constant* constant, const std::string& reg) { 
-    const std::string& value = constant->value;
+void CodeGen::addConstantStringToRegToCode(std::vector<uint8_t>& code, const std::string& value, Reg reg) { 
+    uint32_t string = internString(value);
 
-    rodataContents += value;
-    rodataContents.push_back('\x00');
-    
-    // symbol for the string
-    Symbol sym{};
-    sym.st_name  = 0; // handled later
-    sym.st_info  = ELF64_ST_BIND(LOCAL_SYMBOL) | ELF64_ST_TYPE(OBJECT_SYMBOL_TYPE);
-    sym.st_shndx = 8; // .rodata section index
-    sym.st_value = currentStringsOffset; 
-    sym.st_size  = value.size();
-    currentStringsOffset += value.size() + 1; // include null terminator
-    stringSymbols.push_back(sym);
-    
-    auto movabsCodeStub = movabs(reg,0);
-    size_t stringAddressOffset = code.size() + currentFunctionOffset + register64BitMov[reg].size();
+    // the disp32 follows the rex prefix, opcode and modrm, position independent
+    size_t stringAddressOffset = code.size() + currentFunctionOffset + 3;
     
     // add relocation entry
     Elf64_Rela rel{};
     rel.r_offset = stringAddressOffset;  
-    rel.r_addend = 0;
+    rel.r_addend = -4; // rip is at the end of the disp32
     // rel.r_info is added later
     stringRelaEntries.push_back(rel);
-    addCode(code,movabsCodeStub);
+    stringRelaStrings.push_back(string);
+    leaRip(code,reg);
 } 
 
+// one pool entry and one symbol per distinct literal in the translation unit
+uint32_t CodeGen::internString(const std::string& value) {
+    auto [entry, added] = stringIndices.try_emplace(value,(uint32_t)poolStrings.size());
+    if (added) {
+        poolStrings.push_back(value);
+    }
+    return entry->second;
+}
+
+// .rodata and the string symbols. sorted by their reversed text, a literal that
+// is the tail of the one before it points into it instead of being stored again
+void CodeGen::layoutStringPool() {
+    std::vector<uint32_t> order(poolStrings.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(),order.end(),[this](uint32_t a, uint32_t b) {
+        const std::string& left = poolStrings[a];
+        const std::string& right = poolStrings[b];
+        return std::lexicographical_compare(right.rbegin(),right.rend(),left.rbegin(),left.rend());
+    });
+
+    rodataContents.clear();
+    stringSymbols.assign(poolStrings.size(),Symbol{});
+    const std::string* previous = nullptr;
+    size_t previousOffset = 0;
+    for (uint32_t i : order) {
+        const std::string& value = poolStrings[i];
+        size_t offset;
+        if (previous != nullptr && previous->size() >= value.size()
+            && previous->compare(previous->size() - value.size(),value.size(),value) == 0) {
+            offset = previousOffset + previous->size() - value.size();
+        }
+        else {
+            offset = rodataContents.size();
+            rodataContents += value;
+            rodataContents.push_back('\x00');
+            previous = &value;
+            previousOffset = offset;
+        }
+        Symbol& sym = stringSymbols[i];
+        sym.st_name  = 0; // handled later
+        sym.st_info  = ELF64_ST_BIND(LOCAL_SYMBOL) | ELF64_ST_TYPE(OBJECT_SYMBOL_TYPE);
+        sym.st_shndx = 8; // .rodata section index
+        sym.st_value = offset;
+        sym.st_size  = value.size();
+    }
+}
+
 void CodeGen::addReturnStatementToCode(std::vector<uint8_t>& code ,ReturnStatement* returnStatement) {
-    parseExpressionToReg(code,returnStatement->expression,"rax");
-    addCode(code,leaveFunction());
+    if (returnStatement->expression != nullptr) {
+        parseExpressionToReg(code,returnStatement->expression,Reg::RAX);
+    }
+    jmpTo(code,returnLabel); // the shared epilogue
 }
 
 void CodeGen::addFunctionCallToCode(std::vector<uint8_t>& code,FunctionCall* functionCall) {
     std::vector<ASTNode*>& args = functionCall->arguments;
 
     size_t size = std::min(args.size(),(size_t)6);
+    uint32_t needs[6];
+    size_t callsLeft = 0;
+    for (size_t i = 0; i < size; ++i) {
+        needs[i] = registerNeed(args[i]);
+        callsLeft += (needs[i] >= CALL_NEED);
+    }
+
+    // arguments with calls go first, into temps, a call would clobber the argument registers
+    Reg temps[6];
     for (size_t i = 0; i < size; ++i) {
-        std::string reg = positionToRegister[i];
-        parseExpressionToReg(code,args[i],"rax");
-        addCode(code,pushReg("rax"));
+        if (needs[i] >= CALL_NEED) {
+            --callsLeft;
+            temps[i] = allocateTemp(code,callsLeft > 0,Reg::RAX);
+            parseExpressionToTemp(code,args[i],temps[i]);
+        }
+    }
+
+    // the rest straight into their registers, rdx last since division clobbers it
+    for (size_t i = 0; i < size; ++i) {
+        if (needs[i] < CALL_NEED && positionToRegister[i] != Reg::RDX) {
+            parseExpressionToReg(code,args[i],positionToRegister[i]);
+        }
+    }
+    if (size > 2 && needs[2] < CALL_NEED) {
+        parseExpressionToReg(code,args[2],Reg::RDX);
     }
 
     for (size_t i = size; i > 0 ; --i) {
-        std::string reg = positionToRegister[i-1];
-        addCode(code,popReg(reg));
+        if (needs[i-1] >= CALL_NEED) {
+            movRegReg(code,positionToRegister[i-1],temps[i-1]);
+            releaseTemp(code,temps[i-1]);
+        }
     }
 
+    saveCallerSavedTemps(code,false);
+
     // add .rela.text entry
     Elf64_Rela rel{};
     rel.r_offset = currentFunctionOffset + code.size() + 1;
@@ -610,7 +766,8 @@ void CodeGen::addFunctionCallToCode(std::vector<uint8_t>& code,FunctionCall* fun
     // add reloc.info later (.symtab index + relocation type)
     relaTextEntries.push_back(rel);
     relaFuncStrings.push_back(functionCall->name);
-    addCode(code,call());
+    call(code);
+    saveCallerSavedTemps(code,true);
 }
 
 void CodeGen::addAssignmentToCode(std::vector<uint8_t>& code,Assignment* assignment) {
@@ -618,45 +775,43 @@ void CodeGen::addAssignmentToCode(std::vector<uint8_t>& code,Assignment* assignm
     const ASTNode* identifierNode = assignment->identifier;
     if (identifierNode->type == NodeType::Identifier) {
         Identifier* identifier = (Identifier*)identifierNode;
-        const Variable* var = variableNameToObject[identifier->name];
-        parseExpressionToReg(code,assignment->expression,"rax");
-        addCode(code,movOffsetRbpRax(var->offset,var->getSize()));
+        const Variable* var = lookupVariable(identifier->name);
+        parseExpressionToReg(code,assignment->expression,Reg::RAX);
+        if (var->inRegister) {
+            extendRegReg(code,var->reg,Reg::RAX,var->getSize(),var->isSigned());
+        }
+        else {
+            movOffsetRbpReg(code,var->offset,Reg::RAX,var->getSize());
+        }
+        return;
     }
-    else if (identifierNode->type == NodeType::ArrayAccess) { 
+    bool acrossCall = registerNeed(assignment->expression) >= CALL_NEED;
+    if (identifierNode->type == NodeType::ArrayAccess) { 
         ArrayAccess* arrAccess = (ArrayAccess*)identifierNode;
         // only identifier for now
         if (arrAccess->array->type == NodeType::Identifier) {
-            Identifier* identifier = (Identifier*)arrAccess->array;
-            const Variable* var = variableNameToObject[identifier->name];
-            parseExpressionToReg(code,arrAccess->index,"rax");
-            uint8_t sizeOfElement = var->getElementSize();
-            addCode(code,movabs("rbx",sizeOfElement)); 
-            addCode(code,mulRbx(8));
-            addCode(code,movRegRax("rbx"));
-            parseExpressionToReg(code,identifier,"rax");
-            addCode(code,addRaxRbx());
-            addCode(code,pushReg("rax"));
-            parseExpressionToReg(code,assignment->expression,"rbx");
-            addCode(code,popReg("rax"));
-            addCode(code,movPtrRaxRbx(sizeOfElement));
+            const Variable* var = lookupVariable(((Identifier*)arrAccess->array)->name);
+            Reg address = allocateTemp(code,acrossCall,Reg::RAX);
+            Reg temp;
+            MemOperand element = addElementOperand(code,arrAccess,address,acrossCall,temp);
+            parseExpressionToReg(code,assignment->expression,Reg::RAX);
+            movPtrRegReg(code,element,Reg::RAX,var->getElementSize());
+            if (temp != Reg::RSP) {
+                releaseTemp(code,temp);
+            }
+            releaseTemp(code,address);
         }
     }
     else if (identifierNode->type == NodeType::PropertyAccess) { 
-        PropertyAccess* arrAccess = (PropertyAccess*)identifierNode;
+        PropertyAccess* propAccess = (PropertyAccess*)identifierNode;
         // only identifier for now
-        if (arrAccess->Struct->type == NodeType::Identifier) {
-            Identifier* identifier = (Identifier*)arrAccess->Struct;
-            const Variable* var = variableNameToObject[identifier->name];
-            parseExpressionToReg(code,identifier,"rax");
-            const Variable* structVar = (*structOffsets[var->type])[arrAccess->property];
-            if (structVar->offset > 0) { // optimization, skipping adding 0
-                addCode(code,movabs("rbx",structVar->offset));
-                addCode(code,addRaxRbx());
-            }
-            addCode(code,pushReg("rax"));
-            parseExpressionToReg(code,assignment->expression,"rbx");
-            addCode(code,popReg("rax"));
-            addCode(code,movPtrRaxRbx(structVar->getSize()));
+        if (propAccess->Struct->type == NodeType::Identifier) {
+            Reg address = allocateTemp(code,acrossCall,Reg::RAX);
+            uint8_t size;
+            MemOperand field = addPropertyOperand(code,propAccess,address,size);
+            parseExpressionToReg(code,assignment->expression,Reg::RAX);
+            movPtrRegReg(code,field,Reg::RAX,size);
+            releaseTemp(code,address);
         }
     }
 }
@@ -695,112 +850,280 @@ size_t CodeGen::addDeclarations(const std::vector<ASTNode*>& parameters, size_t
     for (const ASTNode* statement : parameters) {
         if (statement->type == NodeType::VariableDeclaration) {
             VariableDeclaration* d = (VariableDeclaration*)statement;
-            if (d->isLocalArray) {
-                varSizes += d->localArrSize;
-            }
-            else {
-                varSizes += getVarNodeSize(d);
+            auto promoted = promotedLocals.find(d->varName);
+            if (promoted != promotedLocals.end()) { // no stack slot
+                Variable* var = new Variable(0,d->varType,typeSizes[d->varType],d->pointerCount);
+                var->inRegister = true;
+                var->reg = promoted->second;
+                variableNameToObject[d->varName] = var;
+                continue;
             }
-            variableNameToObject[d->varName] = new Variable(varSizes,d->varType,d->pointerCount,
-            d->isLocalArray,d->localArrSize,d->isStruct);
+            varSizes = addVariable(d->varName,d->varType,d->pointerCount,d->isLocalArray,
+            d->localArrSize,d->isStruct,varSizes);
         }
     }
     return varSizes;
 }
 
-void CodeGen::addDeclarationsToCode(std::vector<uint8_t>& code, CodeBlock* codeBlock, std::vector<ASTNode*>& parameters) {
+size_t CodeGen::addVariable(const std::string& name, const std::string& type, size_t pointerCount,
+bool isLocalArray, size_t localArrSize, bool isStruct, size_t varSizes) {
+    if (isLocalArray) {
+        varSizes += localArrSize;
+    }
+    else {
+        varSizes += getVarSize(type,pointerCount);
+    }
+    variableNameToObject[name] = new Variable(varSizes,type,typeSizes[type],pointerCount,isLocalArray,localArrSize,isStruct);
+    return varSizes;
+}
+
+// a typo in one file must not take a batch down, compileFile reports this per file
+CodeGen::Variable* CodeGen::lookupVariable(const std::string& name) {
+    auto found = variableNameToObject.find(name);
+    if (found == variableNameToObject.end()) {
+        throw std::runtime_error("undeclared identifier " + name);
+    }
+    return found->second;
+}
+
+const CodeGen::Variable* CodeGen::lookupField(const Variable* var, const std::string& property) {
+    auto structFound = structOffsets.find(var->type);
+    if (structFound == structOffsets.end()) {
+        throw std::runtime_error("property " + property + " of a " + var->type + ", which is not a struct");
+    }
+    auto found = structFound->second->find(property);
+    if (found == structFound->second->end()) {
+        throw std::runtime_error("struct " + var->type + " has no property " + property);
+    }
+    return found->second;
+}
+
+size_t CodeGen::addDeclarationsToCode(std::vector<uint8_t>& code, CodeBlock* codeBlock, std::vector<ASTNode*>& parameters) {
     size_t varSizes = addDeclarations(parameters);
     varSizes = addDeclarations(codeBlock->statements,varSizes);
-    size_t pad = (16 - (varSizes % 16)) % 16; // pad to 16
-    addCode(code,startFunction());
-    if (varSizes > 0) {
-        addCode(code,subRsp(varSizes + pad));
-    }
     size_t size = std::min(parameters.size(),(size_t)6);
     for (size_t i = 0; i < size; ++i) {
         const std::string& varName = ((VariableDeclaration*)parameters[i])->varName;
-        Variable* var = variableNameToObject[varName];
-        const std::string& reg = positionToRegister[i];
-        addCode(code,movRaxReg(reg));
-        addCode(code,movOffsetRbpRax(var->offset,var->getSize()));
+        Variable* var = lookupVariable(varName);
+        if (var->inRegister) {
+            extendRegReg(code,var->reg,positionToRegister[i],var->getSize(),var->isSigned());
+        }
+        else {
+            movOffsetRbpReg(code,var->offset,positionToRegister[i],var->getSize());
+        }
     }
+    return varSizes;
 }
 
 void CodeGen::addIfStatementToCode(std::vector<uint8_t>& code, IfStatement* ifStatement) {
-    ASTNode* expression = ifStatement->expression;
-    std::string op = "jmp";
-    if (expression->type == NodeType::ComparisonExpression) {
-        op = ((ComparisonExpression*)expression)->op;
-    }
-    parseComparsionExpressionCmp(code,expression);
-    addCode(code,oppositeJump(op));
-    size_t jmpLocation = code.size() - 4;
-    size_t codeSizeBefore = code.size();
+    uint32_t elseLabel = newLabel();
+    Cond cond = parseComparsionExpressionCmp(code,ifStatement->expression);
+    jccTo(code,oppositeCond(cond),elseLabel);
     addCodeBlockToCode(code,ifStatement->codeBlock);
-    uint32_t jmpSize = code.size() - codeSizeBefore;
-    changeJmpOffset(code,jmpLocation,jmpSize);
+    if (ifStatement->elseBlock == nullptr) {
+        bindLabel(code,elseLabel);
+        return;
+    }
+    uint32_t endLabel = newLabel();
+    jmpTo(code,endLabel);
+    bindLabel(code,elseLabel);
+    addCodeBlockToCode(code,ifStatement->elseBlock);
+    bindLabel(code,endLabel);
 }
 
-void CodeGen::parseComparsionExpressionCmp(std::vector<uint8_t>& code, ASTNode* expression) {
-    if (expression->type == NodeType::ComparisonExpression) {
-        ComparisonExpression* compExpr = (ComparisonExpression*)expression;
-        parseExpressionToReg(code,compExpr->left,"rax");
-        addCode(code,pushReg("rax"));
-        parseExpressionToReg(code,compExpr->right,"rbx");
-        addCode(code,popReg("rax"));
-        addCode(code,cmpRaxRbx());
+// sets the flags right before the jcc, so the pair can be fused.
+// returns the condition that holds when expression is true
+Cond CodeGen::parseComparsionExpressionCmp(std::vector<uint8_t>& code, ASTNode* expression) {
+    if (expression->type != NodeType::ComparisonExpression) { // true when not zero
+        addCmpImmToCode(code,expression,0);
+        return Cond::NE;
+    }
+    ComparisonExpression* compExpr = (ComparisonExpression*)expression;
+    uint32_t num;
+    if (isImmediate(compExpr->right,num)) {
+        int sign = addCmpImmToCode(code,compExpr->left,num);
+        return jumpCondition(compExpr->op,sign < 0);
+    }
+    if (isImmediate(compExpr->left,num)) {
+        int sign = addCmpImmToCode(code,compExpr->right,num);
+        return swappedCond(jumpCondition(compExpr->op,sign < 0));
     }
+    Reg leftReg, rightReg;
+    int sign = parseOperandsToRegs(code,compExpr->left,compExpr->right,Reg::RAX,false,leftReg,rightReg);
+    cmpRegReg(code,leftReg,rightReg);
+    releaseTemp(code,(leftReg == Reg::RAX) ? rightReg : leftReg);
+    return jumpCondition(compExpr->op,sign < 0);
+}
+
+// a scalar local is compared in place, anything else is computed into rax first.
+// returns the sign of left
+int CodeGen::addCmpImmToCode(std::vector<uint8_t>& code, ASTNode* left, uint32_t num) {
+    Reg reg = Reg::RAX;
+    int sign = 0;
+    if (left->type == NodeType::Identifier) {
+        const Variable* var = lookupVariable(((Identifier*)left)->name);
+        sign = var->isSigned() ? -1 : 1;
+        // a narrow local is compared at its width, num has to be in its range
+        uint8_t bits = 8 * var->getSize() - var->isSigned();
+        bool fits = bits >= 31 || num < (1u << bits);
+        if (var->inRegister) {
+            reg = var->reg;
+        }
+        else if (!var->isLocalArr && !var->isStruct && fits) {
+            cmpOffsetRbpImm(code,var->offset,num,var->getSize());
+            return sign;
+        }
+    }
+    if (reg == Reg::RAX) {
+        sign = parseExpressionToReg(code,left,reg);
+    }
+    if (num == 0) {
+        testRegReg(code,reg,reg);
+    }
+    else {
+        cmpRegImm(code,reg,num);
+    }
+    return sign;
+}
+
+// -1 signed, 1 unsigned, 0 when only constants are involved. constants take
+// the sign of the other side, mixing signed and unsigned gives unsigned
+int CodeGen::expressionSign(const ASTNode* expression) {
+    switch (expression->type) {
+        case NodeType::Constant:
+            return ((const Constant*)expression)->constantType == "string" ? 1 : 0;
+        case NodeType::Identifier:
+            return lookupVariable(((const Identifier*)expression)->name)->isSigned() ? -1 : 1;
+        case NodeType::ArrayAccess: {
+            const Identifier* array = (const Identifier*)((const ArrayAccess*)expression)->array;
+            return lookupVariable(array->name)->isElementSigned() ? -1 : 1;
+        }
+        case NodeType::PropertyAccess: {
+            const PropertyAccess* propAccess = (const PropertyAccess*)expression;
+            const Variable* var = lookupVariable(((const Identifier*)propAccess->Struct)->name);
+            return lookupField(var,propAccess->property)->isSigned() ? -1 : 1;
+        }
+        case NodeType::UnaryExpression: {
+            const UnaryExpression* unaryExpr = (const UnaryExpression*)expression;
+            if (unaryExpr->op == "*" && unaryExpr->expression->type == NodeType::Identifier) {
+                const Variable* var = lookupVariable(((const Identifier*)unaryExpr->expression)->name);
+                return var->pointerCount == 1 && var->signedType ? -1 : 1;
+            }
+            return 1; // an address
+        }
+        case NodeType::BinaryExpression: {
+            const BinaryExpression* binExpr = (const BinaryExpression*)expression;
+            return combineSigns(expressionSign(binExpr->left),expressionSign(binExpr->right));
+        }
+        case NodeType::ComparisonExpression: {
+            const ComparisonExpression* compExpr = (const ComparisonExpression*)expression;
+            return combineSigns(expressionSign(compExpr->left),expressionSign(compExpr->right));
+        }
+        default:
+            return 0; // calls, their return type isn't known here
+    }
+}
+
+// a constant that a cmp can take as a sign extended imm32
+bool CodeGen::isImmediate(const ASTNode* expression, uint32_t& num) {
+    if (expression->type != NodeType::Constant || ((const Constant*)expression)->constantType != "uint64_t") {
+        return false;
+    }
+    uint64_t value = std::stoll(((const Constant*)expression)->value);
+    if (value > 0x7FFFFFFF) {
+        return false;
+    }
+    num = (uint32_t)value;
+    return true;
 }
 
 void CodeGen::addWhileStatementToCode(std::vector<uint8_t>& code, WhileStatement* whileStatement) {
+    // laid out as: condition, body, condition: branch back to the body.
+    // the first check is a copy of the condition that skips the loop, or
+    // a jump down to the condition when it is more than a compare of two leaves
     ASTNode* expression = whileStatement->expression;
-    std::string op = "jmp";
+    uint32_t bodyLabel = newLabel();
+    uint32_t conditionLabel = newLabel();
+    uint32_t endLabel = newLabel();
+    bool simple = registerNeed(expression) == 1;
     if (expression->type == NodeType::ComparisonExpression) {
-        op = ((ComparisonExpression*)expression)->op;
+        ComparisonExpression* compExpr = (ComparisonExpression*)expression;
+        simple = registerNeed(compExpr->left) == 1 && registerNeed(compExpr->right) == 1;
+    }
+    if (simple) {
+        jccTo(code,oppositeCond(parseComparsionExpressionCmp(code,expression)),endLabel);
+    }
+    else {
+        jmpTo(code,conditionLabel);
     }
-    addCode(code,jump("jmp"));
-    size_t firstJumpLocation = code.size() - 4;
-    size_t codeBlockStart = code.size();
+    bindLabel(code,bodyLabel);
     addCodeBlockToCode(code,whileStatement->codeBlock);
-    size_t firstJumpOffset = code.size() - codeBlockStart;
-    parseComparsionExpressionCmp(code,expression);
-    addCode(code,jump(op));
-    size_t secondJumpLocation = code.size() - 4;
-    size_t secondJumpOffset = codeBlockStart - code.size();
-    
-    changeJmpOffset(code,firstJumpLocation,firstJumpOffset);
-    changeJmpOffset(code,secondJumpLocation,secondJumpOffset);
+    bindLabel(code,conditionLabel);
+    jccTo(code,parseComparsionExpressionCmp(code,expression),bodyLabel);
+    bindLabel(code,endLabel);
 }
 
 std::vector<uint8_t> CodeGen::generateCodeFromFunction(Function* function) {
     std::vector<uint8_t> code;
     CodeBlock* codeBlock = function->codeBlock;
     std::vector<ASTNode*>& params = function->parameters;
-    addDeclarationsToCode(code,codeBlock,params);
+    size_t relaStart = relaTextEntries.size();
+    size_t stringRelaStart = stringRelaEntries.size();
+    usedCalleeSaved = 0;
+    localRegs = 0;
+    promotedLocals.clear();
+    if (promoteLocals) {
+        allocateLocalRegisters(function);
+    }
+    resetRegisterState(0);
+    frameVarSizes = addDeclarationsToCode(code,codeBlock,params);
 
     addCodeBlockToCode(code,codeBlock);
 
     bool inMain = (function->name == entryFunctionName);
     if (inMain) {
-        addCode(code,movabs("rax",0));
+        movImm(code,Reg::RAX,0);
+    }
+    addFunctionFrame(code,function->name,relaStart,stringRelaStart);
+    return code;
+}
+
+// resolves the branches and wraps the body in the prologue and epilogue
+void CodeGen::addFunctionFrame(std::vector<uint8_t>& code, const std::string& name, size_t relaStart, size_t stringRelaStart) {
+    // a final return falls through into the epilogue, its jump is dropped
+    bindLabel(code,returnLabel);
+    resolveBranches(code,relaStart,stringRelaStart);
+
+    // the prologue saves the callee-saved registers the body used, so it is built last
+    std::vector<uint8_t> prologue;
+    addPrologue(prologue);
+    code.insert(code.begin(),prologue.begin(),prologue.end());
+    for (size_t i = relaStart; i < relaTextEntries.size(); ++i) {
+        relaTextEntries[i].r_offset += prologue.size();
+    }
+    for (size_t i = stringRelaStart; i < stringRelaEntries.size(); ++i) {
+        stringRelaEntries[i].r_offset += prologue.size();
     }
-    addCode(code,leaveFunction());
+    addEpilogue(code);
 
-    // add symbol entry
+    addFunctionSymbol(name,code.size());
+    functionSizes.push_back({name,code.size(),frameVarSizes + 8 * frameSlots});
+}
+
+void CodeGen::addFunctionSymbol(const std::string& name, size_t size) {
     Symbol symbol{};
 
     //symbol.st_name  = index in .strtab, taken care of later
     symbol.st_info  = ELF64_ST_BIND(GLOBAL_SYMBOL) | ELF64_ST_TYPE(FUNCTION_SYMBOL_TYPE);
     symbol.st_shndx = 1;                // in .text
     symbol.st_value = currentFunctionOffset; // offset from start of .text
-    symbol.st_size  = code.size();  // function size
+    symbol.st_size  = size;  // function size
     functionSymbols.push_back(symbol);
-    functionSymbolNames.push_back(function->name);
-    localFunctions[function->name] = true;
+    functionSymbolNames.push_back(name);
+    localFunctions[name] = true;
 
-    currentFunctionOffset += code.size();
+    currentFunctionOffset += size;
     variableNameToObject.clear();
-    return code;
 }
 
 void CodeGen::addStruct(Struct* structNode) {
@@ -810,7 +1133,7 @@ void CodeGen::addStruct(Struct* structNode) {
     std::unordered_map<std::string,Variable*>& offsets = (*structOffsets[name]);
     for (const ASTNode* node : structNode->properties) {
         VariableDeclaration* d = (VariableDeclaration*)node;
-        offsets[d->varName] = new Variable(structSize,d->varType,d->pointerCount,
+        offsets[d->varName] = new Variable(structSize,d->varType,typeSizes[d->varType],d->pointerCount,
         d->isLocalArray,d->localArrSize,d->isStruct);
         structSize += getVarNodeSize(d);
     }
@@ -818,10 +1141,14 @@ void CodeGen::addStruct(Struct* structNode) {
 }
 
 size_t CodeGen::getVarNodeSize(VariableDeclaration* node) {
-    if (node->pointerCount > 0) {
+    return getVarSize(node->varType,node->pointerCount);
+}
+
+size_t CodeGen::getVarSize(const std::string& type, size_t pointerCount) {
+    if (pointerCount > 0) {
         return 8; // pointer size is 8 bytes
     }
-    return typeSizes[node->varType];
+    return typeSizes[type];
 }
 
 void CodeGen::changeJmpOffset(std::vector<uint8_t>& code, size_t codeOffset, uint32_t jmpSize) {
@@ -834,4 +1161,8 @@ void CodeGen::changeJmpOffset(std::vector<uint8_t>& code, size_t codeOffset, uin
 
 void CodeGen::addCode(std::vector<uint8_t>& code,const std::vector<uint8_t>& codeToAdd) {
     code.insert(code.end(),codeToAdd.begin(),codeToAdd.end());
+}
+
+void CodeGen::addCode(std::vector<uint8_t>& code, std::initializer_list<uint8_t> codeToAdd) {
+    code.insert(code.end(),codeToAdd.begin(),codeToAdd.end());
 }
\ No newline at end of file
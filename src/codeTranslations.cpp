@@ -1,229 +1,380 @@
 #include "CodeGen.hpp"
 #include <vector>
 #include <unordered_map>
+#include <cstdint>
 
-std::vector<uint8_t> CodeGen::exitSyscall(uint8_t num) {
-    std::vector<uint8_t> code = {
-        0x48, 0xC7, 0xC0, 0x3C, 0x00, 0x00, 0x00, // MOV RAX, 0x3C (EXIT SYSCALL)
-        0x48, 0xC7, 0xC7, num, 0x00, 0x00, 0x00, // MOV RDI, NUM (0-255)
-        0x0F, 0x05 // SYSCALL
-    };
-    return code;
-}
+// every translation function appends its encoding to code
 
-std::vector<uint8_t> CodeGen::call() {
-    return {0xE8, 0x00, 0x00, 0x00, 0x00};
+void CodeGen::call(std::vector<uint8_t>& code) {
+    addCode(code,{0xE8, 0x00, 0x00, 0x00, 0x00});
     // the address of the call is being relocated by .rela.text
 } // call 0x00000000
 
-std::vector<uint8_t> CodeGen::movabs(const std::string& reg, uint64_t num) {
-    std::vector<uint8_t> code = register64BitMov[reg];
-    addNumToCode(code, num, 8);
-    return code;
-} // movabs reg, num
-
-std::vector<uint8_t> CodeGen::leaStub(const std::string& reg) { 
-    std::vector<uint8_t> leaCode = register64BitLeaStub[reg];
-    addCode(leaCode,{0x00,0x00,0x00,0x00});
-    return leaCode;
-} // lea reg, 0x00000000
-
-std::vector<uint8_t> CodeGen::pushReg(const std::string& reg) { 
-    return pushRegCode[reg];
+void CodeGen::movImm(std::vector<uint8_t>& code, Reg reg, uint64_t num) {
+    if (num == 0) { // clobbers the flags, nothing keeps them alive across a constant
+        emitRegReg(code,0x31,reg,reg,4);
+    }
+    else if (num <= 0xFFFFFFFF) { // writing a 32 bit register clears the top half
+        if (isExtendedReg(reg)) {
+            code.push_back(rex(false,false,false,true));
+        }
+        code.push_back(0xB8 + regCode(reg));
+        addNumToCode(code,num,4);
+    }
+    else if (fitsInt32(num)) {
+        emitDigitReg(code,0xC7,0,reg,8); // C7 /0, sign extended
+        addNumToCode(code,num,4);
+    }
+    else {
+        code.push_back(rex(true,false,false,isExtendedReg(reg)));
+        code.push_back(0xB8 + regCode(reg));
+        addNumToCode(code,num,8);
+    }
+} // xor reg32, reg32 / mov reg32, num / mov reg, simm32 / movabs reg, num
+
+void CodeGen::leaRip(std::vector<uint8_t>& code, Reg reg) { 
+    code.push_back(rex(true,isExtendedReg(reg),false,false));
+    code.push_back(0x8D);
+    code.push_back(modRM(0,regCode(reg),5)); // rip relative
+    addNumToCode(code, 0, 4);
+} // lea reg, [rip+0x00000000], the displacement is relocated
+
+void CodeGen::pushReg(std::vector<uint8_t>& code, Reg reg) { 
+    if (isExtendedReg(reg)) {
+        code.push_back(rex(false,false,false,true));
+    }
+    code.push_back(0x50 + regCode(reg));
 } // push reg
 
-std::vector<uint8_t> CodeGen::popReg(const std::string& reg) { 
-    return popRegCode[reg];
+void CodeGen::popReg(std::vector<uint8_t>& code, Reg reg) { 
+    if (isExtendedReg(reg)) {
+        code.push_back(rex(false,false,false,true));
+    }
+    code.push_back(0x58 + regCode(reg));
 } // pop reg
 
-std::vector<uint8_t> CodeGen::leave() { 
-    return {0xC9};
+void CodeGen::leave(std::vector<uint8_t>& code) { 
+    code.push_back(0xC9);
 } // leave, which is: 
 // mov rsp, rbp
 // pop rbp
 
-std::vector<uint8_t> CodeGen::leaveFunction() {
-    return {0xC9,0xC3};
+void CodeGen::leaveFunction(std::vector<uint8_t>& code) {
+    addCode(code,{0xC9,0xC3});
 } // leave then ret
 
-std::vector<uint8_t> CodeGen::startFunction() {
-    return {0x55,0x48,0x89,0xE5};
+void CodeGen::startFunction(std::vector<uint8_t>& code) {
+    addCode(code,{0x55,0x48,0x89,0xE5});
 } // push rbp & mov rbp,rsp 
 
-std::vector<uint8_t> CodeGen::ret() { 
-    return {0xC3};
+void CodeGen::ret(std::vector<uint8_t>& code) { 
+    code.push_back(0xC3);
 } // ret
 
-std::vector<uint8_t> CodeGen::movRspRbp() { 
-    return {0x48,0x89,0xE5};
-} // mov rbp, rsp
-
-std::vector<uint8_t> CodeGen::movRaxOffsetRbp(uint32_t offset, uint8_t size) { 
-    std::vector<uint8_t> code = {0x48,0x8b,0x85}; // mov rax, qword ptr [rbp-offset]
-    if (size == 4)
-        code = {0x8b,0x85}; // mov eax, dword ptr [rbp-offset]
-    if (size == 2)
-        code = {0x66,0x8b,0x85}; // mov ax, word ptr [rbp-offset]
-    if (size == 1)
-        code = {0x8a,0x85}; // mov al, byte ptr [rbp-offset]
-    offset = ~offset + 1;
-    addNumToCode(code,offset,4);
-    return code;
-} // mov rax/eax/ax/al, qword/dword/word/byte ptr [rbp-0xOFFSET]
-
-std::vector<uint8_t> CodeGen::movOffsetRbpRax(uint32_t offset, uint8_t size) { 
-    std::vector<uint8_t> code = {0x48,0x89,0x85}; // mov qword ptr [rbp-offset], rax
-    if (size == 4)
-        code = {0x89,0x85}; // mov dword ptr [rbp-offset], eax
-    if (size == 2)
-        code = {0x66,0x89,0x85}; // mov word ptr [rbp-offset], ax
-    if (size == 1)
-        code = {0x88,0x85}; // mov byte ptr [rbp-offset], al
-    offset = ~offset + 1;
-    addNumToCode(code,offset,4);
-    return code;
-} // mov Qword/Dword/Word/Byte ptr [rbp-0xOFFSET], Rax/Eax/Ax/Al
-
-std::vector<uint8_t> CodeGen::leaRaxOffsetRbp(uint32_t offset) { 
-    std::vector<uint8_t> code = {0x48,0x8d,0x85};
-    offset = ~offset + 1;
-    addNumToCode(code,offset,4);
-    return code;
-} // lea rax, [rbp-0xOFFSET]
-// lea rax, [rbp+rax*8+6]
-
-std::vector<uint8_t> CodeGen::subRsp(uint32_t num) { 
-    std::vector<uint8_t> code = {0x48,0x81,0xEC};
-    addNumToCode(code,num,4);
-    return code;
+void CodeGen::movRegOffsetRbp(std::vector<uint8_t>& code, Reg reg, uint32_t offset, uint8_t size) { 
+    emitRegMem(code,size == 1 ? 0x8A : 0x8B,reg,{Reg::RBP,-(int32_t)offset},size);
+} // mov reg, qword/dword/word/byte ptr [rbp-0xOFFSET]
+
+void CodeGen::movOffsetRbpReg(std::vector<uint8_t>& code, uint32_t offset, Reg reg, uint8_t size) { 
+    emitRegMem(code,size == 1 ? 0x88 : 0x89,reg,{Reg::RBP,-(int32_t)offset},size);
+} // mov qword/dword/word/byte ptr [rbp-0xOFFSET], reg
+
+void CodeGen::leaRegOffsetRbp(std::vector<uint8_t>& code, Reg reg, uint32_t offset) { 
+    emitRegMem(code,0x8D,reg,{Reg::RBP,-(int32_t)offset},8);
+} // lea reg, [rbp-0xOFFSET]
+
+void CodeGen::subRsp(std::vector<uint8_t>& code, uint32_t num) { 
+    emitDigitRegImm(code,5,Reg::RSP,num); // 83 /5 or 81 /5
 } // sub rsp, num
 
-std::vector<uint8_t> CodeGen::movRegRax(const std::string& reg) { 
-    return movRegRaxMap[reg];
-} // mov reg, rax
-
-std::vector<uint8_t> CodeGen::movRaxReg(const std::string& reg) { 
-    return movRaxRegMap[reg];
-} // mov rax, reg
-
-std::vector<uint8_t> CodeGen::addRaxRbx() { 
-    return {0x48,0x01,0xd8};
-} // add rax, rbx
-
-std::vector<uint8_t> CodeGen::subRaxRbx() { 
-    return {0x48,0x29,0xd8};
-} // sub rax, rbx
-
-std::vector<uint8_t> CodeGen::mulRbx(uint8_t size) {
-    if (size == 4)
-        return {0xf7,0xe3};
-    if (size == 2)
-        return {0x66,0xf7,0xe3};
-    if (size == 1)
-        return {0xf6,0xe3};
-    return {0x48,0xf7,0xe3};
-} // mul rbx (result in rdx:rax)
-
-std::vector<uint8_t> CodeGen::divRbx(uint8_t size) {
-    if (size == 4)
-        return {0xf7,0xf3};
-    if (size == 2)
-        return {0x66,0xf7,0xf3};
-    if (size == 1)
-        return {0xf6,0xf3};
-    return {0x48,0xf7,0xf3};
-} // div rbx (RAX quotient, RDX remainder)
-
-std::vector<uint8_t> CodeGen::cmpRaxRbx() { 
-    return {0x48,0x39,0xd8};
-} // cmp rax, rbx
-
-std::vector<uint8_t> CodeGen::oppositeJump(const std::string& type) { 
-    std::string oppositeOp = oppositeJumpType[type];
-    std::vector<uint8_t> jmp = jumpType[oppositeOp];
-    addCode(jmp,{0x00,0x00,0x00,0x00});
-    return jmp;
-} // je/jne/ja/jb/jae/jbe 0x00000000
+void CodeGen::movRegReg(std::vector<uint8_t>& code, Reg dst, Reg src) { 
+    emitRegReg(code,0x89,src,dst,8);
+} // mov dst, src
+
+void CodeGen::movzxRegReg(std::vector<uint8_t>& code, Reg dst, Reg src, uint8_t size) {
+    if (size == 8) {
+        movRegReg(code,dst,src);
+    }
+    else if (size == 4) {
+        emitRegReg(code,0x89,src,dst,4); // writing a 32 bit register clears the top half
+    }
+    else {
+        emitPrefixes(code,size == 1 ? 1 : 4,true,dst,true,src);
+        code.push_back(0x0F);
+        code.push_back(size == 1 ? 0xB6 : 0xB7);
+        code.push_back(modRM(3,regCode(dst),regCode(src)));
+    }
+} // mov dst, src truncated to size and zero extended
 
-std::vector<uint8_t> CodeGen::jump(const std::string& type) { 
-    std::vector<uint8_t> jmp = jumpType[type];
-    addCode(jmp,{0x00,0x00,0x00,0x00});
-    return jmp;
+void CodeGen::movsxRegReg(std::vector<uint8_t>& code, Reg dst, Reg src, uint8_t size) {
+    if (size == 8) {
+        movRegReg(code,dst,src);
+        return;
+    }
+    emitPrefixes(code,8,true,dst,true,src);
+    if (size == 4) {
+        code.push_back(0x63); // movsxd
+    }
+    else {
+        code.push_back(0x0F);
+        code.push_back(size == 1 ? 0xBE : 0xBF);
+    }
+    code.push_back(modRM(3,regCode(dst),regCode(src)));
+} // mov dst, src truncated to size and sign extended
+
+void CodeGen::extendRegReg(std::vector<uint8_t>& code, Reg dst, Reg src, uint8_t size, bool isSigned) {
+    if (isSigned) {
+        movsxRegReg(code,dst,src,size);
+    }
+    else {
+        movzxRegReg(code,dst,src,size);
+    }
+}
+
+void CodeGen::addRegReg(std::vector<uint8_t>& code, Reg dst, Reg src) { 
+    emitRegReg(code,0x01,src,dst,8);
+} // add dst, src
+
+void CodeGen::subRegReg(std::vector<uint8_t>& code, Reg dst, Reg src) { 
+    emitRegReg(code,0x29,src,dst,8);
+} // sub dst, src
+
+void CodeGen::addRegImm(std::vector<uint8_t>& code, Reg reg, uint32_t num) { 
+    emitDigitRegImm(code,0,reg,num); // 83 /0 or 81 /0
+} // add reg, num
+
+void CodeGen::subRegImm(std::vector<uint8_t>& code, Reg reg, uint32_t num) { 
+    emitDigitRegImm(code,5,reg,num); // 83 /5 or 81 /5
+} // sub reg, num
+
+void CodeGen::imulRegReg(std::vector<uint8_t>& code, Reg dst, Reg src) {
+    emitPrefixes(code,8,true,dst,true,src);
+    code.push_back(0x0F);
+    code.push_back(0xAF);
+    code.push_back(modRM(3,regCode(dst),regCode(src)));
+} // imul dst, src (low 64 bits, same for signed and unsigned)
+
+void CodeGen::imulRegImm(std::vector<uint8_t>& code, Reg dst, Reg src, uint32_t num) {
+    if (fitsInt8((int32_t)num)) {
+        emitRegReg(code,0x6B,dst,src,8);
+        code.push_back((uint8_t)num);
+        return;
+    }
+    emitRegReg(code,0x69,dst,src,8);
+    addNumToCode(code,num,4);
+} // imul dst, src, num
+
+void CodeGen::shlRegImm(std::vector<uint8_t>& code, Reg reg, uint8_t count) {
+    emitDigitReg(code,0xC1,4,reg,8);
+    code.push_back(count);
+} // shl reg, count
+void CodeGen::shrRegImm(std::vector<uint8_t>& code, Reg reg, uint8_t count) {
+    emitDigitReg(code,0xC1,5,reg,8);
+    code.push_back(count);
+} // shr reg, count
+void CodeGen::andRegImm(std::vector<uint8_t>& code, Reg reg, uint64_t mask) {
+    if (mask <= 0x7FFFFFFF) {
+        emitDigitRegImm(code,4,reg,(uint32_t)mask);
+    }
+    else if (mask == 0xFFFFFFFF) {
+        movzxRegReg(code,reg,reg,4);
+    }
+    else { // the imm32 would be sign extended, clear the top bits by shifting them out
+        uint8_t clear = 0;
+        while (clear < 64 && !(mask & (1ULL << (63 - clear)))) {
+            ++clear;
+        }
+        shlRegImm(code,reg,clear);
+        shrRegImm(code,reg,clear);
+    }
+} // and reg, mask (a low bit mask)
+void CodeGen::divReg(std::vector<uint8_t>& code, Reg reg, uint8_t size) {
+    emitDigitReg(code,size == 1 ? 0xF6 : 0xF7,6,reg,size); // F7 /6
+} // div reg (RAX quotient, RDX remainder)
+
+void CodeGen::idivReg(std::vector<uint8_t>& code, Reg reg) {
+    emitDigitReg(code,0xF7,7,reg,8); // F7 /7
+} // idiv reg (RAX quotient, RDX remainder, both rounded toward zero)
+
+void CodeGen::cqo(std::vector<uint8_t>& code) {
+    addCode(code,{0x48,0x99});
+} // cqo, RDX = the sign of RAX
+
+void CodeGen::cmpRegReg(std::vector<uint8_t>& code, Reg left, Reg right) { 
+    emitRegReg(code,0x39,right,left,8);
+} // cmp left, right
+
+void CodeGen::cmpRegImm(std::vector<uint8_t>& code, Reg reg, uint32_t num) { 
+    emitDigitRegImm(code,7,reg,num); // 83 /7 or 81 /7
+} // cmp reg, num
+
+void CodeGen::cmpOffsetRbpImm(std::vector<uint8_t>& code, uint32_t offset, uint32_t num, uint8_t size) { 
+    bool imm8 = (size == 1) || fitsInt8((int32_t)num);
+    emitPrefixes(code,size,false,Reg::RAX,false,Reg::RBP);
+    code.push_back(size == 1 ? 0x80 : imm8 ? 0x83 : 0x81);
+    emitMemOperand(code,Reg::RDI,{Reg::RBP,-(int32_t)offset}); // rdi encodes /7
+    addNumToCode(code,num,imm8 ? 1 : size == 2 ? 2 : 4);
+} // cmp qword/dword/word/byte ptr [rbp-0xOFFSET], num
+
+void CodeGen::testRegReg(std::vector<uint8_t>& code, Reg left, Reg right) { 
+    emitRegReg(code,0x85,right,left,8);
+} // test left, right
+
+void CodeGen::jmp(std::vector<uint8_t>& code) { 
+    addCode(code,{0xE9,0x00,0x00,0x00,0x00});
+} // jmp 0x00000000
+
+void CodeGen::jcc(std::vector<uint8_t>& code, Cond cond) { 
+    addCode(code,{0x0F,(uint8_t)(0x80 | (uint8_t)cond),0x00,0x00,0x00,0x00});
 } // je/jne/ja/jb/jae/jbe 0x00000000
 
-std::vector<uint8_t> CodeGen::movRaxQwordRax() {
-    return {0x48,0x8b,0x00};
-} // mov rax, [rax]
+void CodeGen::movRegPtrReg(std::vector<uint8_t>& code, Reg dst, Reg base) {
+    emitRegMem(code,0x8B,dst,{base},8);
+} // mov dst, [base]
 
-std::vector<uint8_t> CodeGen::movPtrRaxRbx(uint8_t size) {
-    if (size == 8)
-        return {0x48,0x89,0x18}; // mov [rax], Rbx
-    if (size == 4)
-        return {0x89,0x18}; // mov [rax], Ebx
-    if (size == 2)
-        return {0x66,0x89,0x18}; // mov [rax], Bx
-    return {0x88,0x18}; // mov [rax], bl
-} // mov Qword/Dword/Word/Byte ptr [rax], Rbx/Ebx/Bx/Bl
+void CodeGen::movPtrRegReg(std::vector<uint8_t>& code, const MemOperand& mem, Reg src, uint8_t size) {
+    emitRegMem(code,size == 1 ? 0x88 : 0x89,src,mem,size);
+} // mov Qword/Dword/Word/Byte ptr [base+index*scale+disp], src
+
+void CodeGen::leaRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem) {
+    emitRegMem(code,0x8D,dst,mem,8);
+} // lea dst, [base+index*scale+disp]
+
+void CodeGen::movzxRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem, uint8_t size) {
+    if (size >= 4) {
+        emitRegMem(code,0x8B,dst,mem,size);
+        return;
+    }
+    emitPrefixes(code,4,true,dst,false,mem.base,isIndexExtended(mem));
+    code.push_back(0x0F);
+    code.push_back(size == 1 ? 0xB6 : 0xB7);
+    emitMemOperand(code,dst,mem);
+} // mov/movzx dst, qword/dword/word/byte ptr [base+index*scale+disp], zero extended
+
+void CodeGen::movsxRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem, uint8_t size) {
+    if (size == 8) {
+        emitRegMem(code,0x8B,dst,mem,8);
+        return;
+    }
+    emitPrefixes(code,8,true,dst,false,mem.base,isIndexExtended(mem));
+    if (size == 4) {
+        code.push_back(0x63); // movsxd
+    }
+    else {
+        code.push_back(0x0F);
+        code.push_back(size == 1 ? 0xBE : 0xBF);
+    }
+    emitMemOperand(code,dst,mem);
+} // mov/movsx dst, qword/dword/word/byte ptr [base+index*scale+disp], sign extended
+
+void CodeGen::loadRegMem(std::vector<uint8_t>& code, Reg dst, const MemOperand& mem, uint8_t size, bool isSigned) {
+    if (size != 1 && size != 2 && size != 4) { // pointers, and the first 8 bytes of anything larger
+        size = 8;
+    }
+    if (isSigned) {
+        movsxRegMem(code,dst,mem,size);
+    }
+    else {
+        movzxRegMem(code,dst,mem,size);
+    }
+}
+void CodeGen::emitPrefixes(std::vector<uint8_t>& code, uint8_t size, bool regIsReg, Reg reg, bool rmIsReg, Reg rm, bool extendedIndex) {
+    if (size == 2) {
+        code.push_back(0x66); // operand size prefix
+    }
+    bool w = (size == 8);
+    bool r = regIsReg && isExtendedReg(reg);
+    bool b = isExtendedReg(rm);
+    // spl/bpl/sil/dil are only reachable with a REX prefix
+    bool byteReg = (size == 1) && ((regIsReg && regCode(reg) >= 4) || (rmIsReg && regCode(rm) >= 4));
+    if (w || r || extendedIndex || b || byteReg) {
+        code.push_back(rex(w,r,extendedIndex,b));
+    }
+}
+
+void CodeGen::emitRegReg(std::vector<uint8_t>& code, uint8_t opcode, Reg reg, Reg rm, uint8_t size) {
+    emitPrefixes(code,size,true,reg,true,rm);
+    code.push_back(opcode);
+    code.push_back(modRM(3,regCode(reg),regCode(rm)));
+}
+
+void CodeGen::emitDigitReg(std::vector<uint8_t>& code, uint8_t opcode, uint8_t digit, Reg rm, uint8_t size) {
+    emitPrefixes(code,size,false,Reg::RAX,true,rm);
+    code.push_back(opcode);
+    code.push_back(modRM(3,digit,regCode(rm)));
+}
+
+void CodeGen::emitDigitRegImm(std::vector<uint8_t>& code, uint8_t digit, Reg rm, uint32_t num) {
+    if (fitsInt8((int32_t)num)) {
+        emitDigitReg(code,0x83,digit,rm,8); // sign extended imm8
+        code.push_back((uint8_t)num);
+        return;
+    }
+    emitDigitReg(code,0x81,digit,rm,8);
+    addNumToCode(code,num,4);
+} // the group 1 alu ops (add/or/adc/sbb/and/sub/xor/cmp) with the shortest immediate
+
+void CodeGen::emitRegMem(std::vector<uint8_t>& code, uint8_t opcode, Reg reg, const MemOperand& mem, uint8_t size) {
+    emitPrefixes(code,size,true,reg,false,mem.base,isIndexExtended(mem));
+    code.push_back(opcode);
+    emitMemOperand(code,reg,mem);
+}
+bool CodeGen::fitsInt8(int64_t num) {
+    return num >= -128 && num <= 127;
+}
+
+bool CodeGen::fitsInt32(uint64_t num) {
+    return (int64_t)num >= INT32_MIN && (int64_t)num <= INT32_MAX;
+}
+
+void CodeGen::emitMemOperand(std::vector<uint8_t>& code, Reg reg, const MemOperand& mem) {
+    // [rbp]/[r13] have no mod 00 form, they need a displacement
+    uint8_t mod = 2;
+    if (mem.disp == 0 && regCode(mem.base) != regCode(Reg::RBP)) {
+        mod = 0;
+    }
+    else if (fitsInt8(mem.disp)) {
+        mod = 1;
+    }
+    if (mem.scale != 0) {
+        uint8_t scaleBits = (mem.scale == 8) ? 3 : (mem.scale == 4) ? 2 : (mem.scale == 2) ? 1 : 0;
+        code.push_back(modRM(mod,regCode(reg),4)); // rm 100, a SIB byte follows
+        code.push_back(sib(scaleBits,regCode(mem.index),regCode(mem.base)));
+    }
+    else {
+        code.push_back(modRM(mod,regCode(reg),regCode(mem.base)));
+        if (regCode(mem.base) == regCode(Reg::RSP)) { // [rsp]/[r12] need a SIB byte
+            code.push_back(sib(0,4,4));
+        }
+    }
+    if (mod == 1) {
+        code.push_back((uint8_t)(int8_t)mem.disp);
+    }
+    else if (mod == 2) {
+        addNumToCode(code,(uint32_t)mem.disp,4);
+    }
+}
+
+bool CodeGen::isIndexExtended(const MemOperand& mem) {
+    return mem.scale != 0 && isExtendedReg(mem.index);
+}
 
 void CodeGen::addNumToCode(std::vector<uint8_t>& code, uint64_t num, uint8_t size) {
-    uint8_t* bytePtr = reinterpret_cast<uint8_t*>(&num);
     for (size_t i = 0; i < size; ++i) {
-        code.push_back(*(bytePtr + i));
+        code.push_back((uint8_t)(num >> (i * 8)));
     }
 }
 
-std::unordered_map<uint8_t,std::string> CodeGen::positionToRegister = {
-    {0,"rdi"},
-    {1,"rsi"},
-    {2,"rdx"},
-    {3,"rcx"},
-    {4,"r8"},
-    {5,"r9"}
-};
-
-std::unordered_map<std::string,std::vector<uint8_t>> CodeGen::register64BitMov {
-    {"rax",{0x48,0xb8}},
-    {"rbx",{0x48,0xbb}},
-    {"rcx",{0x48,0xb9}},
-    {"rdx",{0x48,0xba}},
-    {"rdi",{0x48,0xbf}},
-    {"rsi",{0x48,0xbe}},
-    {"rdx",{0x48,0xba}},
-    {"rcx",{0x48,0xb9}},
-    {"r9",{0x49,0xb9}},
-    {"r8",{0x49,0xb8}}
-};
-
-std::unordered_map<std::string,std::vector<uint8_t>> CodeGen::register64BitLeaStub {
-    {"rdi",{0x48,0x8d,0x3c,0x25}},
-    {"rsi",{0x48,0x8d,0x34,0x25}},
-    {"rdx",{0x48,0x8d,0x14,0x25}},
-    {"rcx",{0x48,0x8d,0x0c,0x25}},
-    {"r9",{0x4c,0x8d,0x0c,0x25}},
-    {"r8",{0x4c,0x8d,0x04,0x25}}
-};
-
-std::unordered_map<std::string,std::vector<uint8_t>> CodeGen::movRegRaxMap {
-    {"rbx",{0x48,0x89,0xc3}},
-    {"rdi",{0x48,0x89,0xc7}},
-    {"rsi",{0x48,0x89,0xc6}},
-    {"rdx",{0x48,0x89,0xc2}},
-    {"rcx",{0x48,0x89,0xc1}},
-    {"r9",{0x49,0x89,0xc1}},
-    {"r8",{0x49,0x89,0xc0}}
-};
-
-std::unordered_map<std::string,std::vector<uint8_t>> CodeGen::movRaxRegMap {
-    {"rdi", {0x48,0x89,0xf8}},  
-    {"rsi", {0x48,0x89,0xf0}},  
-    {"rdx", {0x48,0x89,0xd0}},  
-    {"rcx", {0x48,0x89,0xc8}},  
-    {"r8", {0x4c,0x89,0xc0}},  
-    {"r9", {0x4c,0x89,0xc8}},  
-    {"rdx",{0x48,0x89,0xd0}},
-};
-
-std::unordered_map<std::string,uint8_t> CodeGen::typeSizes {
+Cond CodeGen::jumpCondition(const std::string& op, bool isSigned) {
+    if (op == "==") return Cond::E;
+    if (op == "!=") return Cond::NE;
+    if (op == ">") return isSigned ? Cond::G : Cond::A;
+    if (op == "<") return isSigned ? Cond::L : Cond::B;
+    if (op == ">=") return isSigned ? Cond::GE : Cond::AE;
+    return isSigned ? Cond::LE : Cond::BE; // <=
+}
+
+const std::unordered_map<std::string,uint8_t> CodeGen::builtinTypeSizes {
     {"uint8_t",1},
     {"uint16_t",2},
     {"uint32_t",4},
@@ -232,49 +383,4 @@ std::unordered_map<std::string,uint8_t> CodeGen::typeSizes {
     {"short",2},
     {"int",4},
     {"long long",8},
-};
-
-std::unordered_map<std::string,std::vector<uint8_t>> CodeGen::pushRegCode {
-    {"rax",{0x50}},
-    {"rbx",{0x53}},
-    {"rcx",{0x51}},
-    {"rdx",{0x52}},
-    {"rbp",{0x55}},
-    {"rsp",{0x54}},
-    {"rdi",{0x57}},
-    {"rsi",{0x56}},
-    {"r8",{0x41,0x50}},
-    {"r9",{0x41,0x51}},
-};
-
-std::unordered_map<std::string,std::vector<uint8_t>> CodeGen::popRegCode {
-    {"rax",{0x58}},
-    {"rbx",{0x5b}},
-    {"rcx",{0x59}},
-    {"rdx",{0x5a}},
-    {"rbp",{0x5d}},
-    {"rsp",{0x5c}},
-    {"rdi",{0x5f}},
-    {"rsi",{0x5e}},
-    {"r8",{0x41,0x58}},
-    {"r9",{0x41,0x59}},
-};
-
-std::unordered_map<std::string,std::vector<uint8_t>> CodeGen::jumpType {
-    {"jmp",{0xe9}},     // jmp
-    {"==",{0x0f,0x84}}, // je
-    {"!=",{0x0f,0x85}}, // jne
-    {">",{0x0f,0x87}},  // ja
-    {"<",{0x0f,0x82}},  // jb
-    {">=",{0x0f,0x83}}, // jae
-    {"<=",{0x0f,0x86}}, // jbe
-};
-
-std::unordered_map<std::string,std::string> CodeGen::oppositeJumpType {
-    {"!=","=="}, 
-    {"==","!="}, 
-    {"<=",">"}, 
-    {">=","<"}, 
-    {"<",">="},  
-    {">","<="},  
 };
\ No newline at end of file
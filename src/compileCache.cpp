@@ -0,0 +1,211 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "compileCache.hpp"
+#include "CodeGen.hpp"
+#include "hash.hpp"
+
+namespace fs = std::filesystem;
+
+// objects and functions made by another code generator are never served. an explicit version,
+// a build stamp would only change with this file and differ between identical builds
+static const std::string objectVersion = "object " + std::to_string(CodeGen::CODE_VERSION);
+static const std::string functionVersion = "function " + std::to_string(CodeGen::CODE_VERSION);
+
+static const char* statsFileName = "stats";
+
+// whole objects and single functions, evicted together
+static bool isEntry(const fs::path& path) {
+    return path.extension() == ".o" || path.extension() == ".fn";
+}
+
+CompileCache::CompileCache(const std::string& directory, uint64_t maxBytes) : directory(directory), maxBytes(maxBytes) {
+    std::error_code error;
+    fs::create_directories(directory,error);
+}
+
+std::string CompileCache::key(const std::string& preprocessedCode,
+    const std::unordered_map<std::string,std::string>& macros, const std::string& options) {
+    Hash128 hash;
+    hash.add(objectVersion);
+    hash.add(options);
+    std::vector<std::pair<std::string,std::string>> sortedMacros(macros.begin(),macros.end());
+    std::sort(sortedMacros.begin(),sortedMacros.end());
+    for (const auto& [name, value] : sortedMacros) {
+        hash.add(name);
+        hash.add(value);
+    }
+    hash.add(preprocessedCode);
+    return hash.hex();
+}
+
+std::string CompileCache::entryPath(const std::string& key, const char* extension) const {
+    return (fs::path(directory) / (key + extension)).string();
+}
+
+// written under a unique name first and renamed, so nobody ever sees half an entry
+static std::string temporaryPath(const std::string& path) {
+    static std::atomic<uint64_t> counter{0};
+    std::ostringstream temporary;
+    temporary << path << ".tmp" << std::hash<std::thread::id>()(std::this_thread::get_id()) << "_" << counter++;
+    return temporary.str();
+}
+
+static bool publish(const std::string& temporary, const std::string& path) {
+    std::error_code error;
+    fs::rename(temporary,path,error);
+    if (error) {
+        fs::remove(temporary,error);
+        return false;
+    }
+    return true;
+}
+
+bool CompileCache::fetch(const std::string& key, const std::string& objectFile) {
+    std::error_code error;
+    std::string entry = entryPath(key,".o");
+    bool hit = fs::exists(entry,error)
+        && fs::copy_file(entry,objectFile,fs::copy_options::overwrite_existing,error);
+    if (hit) {
+        fs::last_write_time(entry,fs::file_time_type::clock::now(),error); // most recently used
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++(hit ? stats.hits : stats.misses);
+    return hit;
+}
+
+void CompileCache::store(const std::string& key, const std::string& objectFile) {
+    std::string temporary = temporaryPath(entryPath(key,".o"));
+    std::error_code error;
+    if (!fs::copy_file(objectFile,temporary,fs::copy_options::overwrite_existing,error)
+        || !publish(temporary,entryPath(key,".o"))) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++stats.stores;
+}
+
+std::string CompileCache::functionKey(const std::string& fingerprint) {
+    Hash128 hash;
+    hash.add(functionVersion);
+    hash.add(fingerprint);
+    return hash.hex();
+}
+
+bool CompileCache::fetchFunction(const std::string& fingerprint, std::string& data) {
+    std::string entry = entryPath(functionKey(fingerprint),".fn");
+    std::ifstream file(entry,std::ios::binary);
+    bool hit = file.is_open();
+    if (hit) {
+        data.assign(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+        std::error_code error;
+        fs::last_write_time(entry,fs::file_time_type::clock::now(),error);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++(hit ? stats.functionHits : stats.functionMisses);
+    return hit;
+}
+
+void CompileCache::storeFunction(const std::string& fingerprint, const std::string& data) {
+    std::string entry = entryPath(functionKey(fingerprint),".fn");
+    std::string temporary = temporaryPath(entry);
+    {
+        std::ofstream file(temporary,std::ios::binary);
+        file.write(data.data(),data.size());
+        if (!file) {
+            return;
+        }
+    }
+    publish(temporary,entry);
+}
+
+void CompileCache::evict() {
+    struct Entry {
+        fs::path path;
+        fs::file_time_type lastUse;
+        uintmax_t size;
+    };
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code error;
+    std::vector<Entry> entries;
+    uint64_t totalBytes = 0;
+    for (const fs::directory_entry& file : fs::directory_iterator(directory,error)) {
+        if (!isEntry(file.path())) {
+            continue;
+        }
+        Entry entry = {file.path(), file.last_write_time(error), file.file_size(error)};
+        if (!error) {
+            entries.push_back(entry);
+            totalBytes += entry.size;
+        }
+    }
+    if (totalBytes <= maxBytes) {
+        return;
+    }
+    std::sort(entries.begin(),entries.end(),[](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+    for (const Entry& entry : entries) {
+        if (totalBytes <= maxBytes) {
+            break;
+        }
+        if (fs::remove(entry.path,error)) {
+            totalBytes -= entry.size;
+            ++stats.evictions;
+        }
+    }
+}
+
+CompileCache::Stats CompileCache::loadStats() const {
+    Stats total;
+    std::ifstream file(fs::path(directory) / statsFileName);
+    file >> total.hits >> total.misses >> total.stores >> total.evictions >> total.functionHits >> total.functionMisses;
+    return file ? total : Stats();
+}
+
+void CompileCache::saveStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats total = loadStats();
+    total.hits += stats.hits;
+    total.misses += stats.misses;
+    total.stores += stats.stores;
+    total.evictions += stats.evictions;
+    total.functionHits += stats.functionHits;
+    total.functionMisses += stats.functionMisses;
+    fs::path path = fs::path(directory) / statsFileName;
+    fs::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary);
+        file << total.hits << " " << total.misses << " " << total.stores << " " << total.evictions << " "
+        << total.functionHits << " " << total.functionMisses << "\n";
+    }
+    std::error_code error;
+    fs::rename(temporary,path,error);
+}
+
+void CompileCache::printStats(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats total = loadStats();
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    std::error_code error;
+    for (const fs::directory_entry& file : fs::directory_iterator(directory,error)) {
+        if (isEntry(file.path())) {
+            ++entries;
+            bytes += file.file_size(error);
+        }
+    }
+    uint64_t lookups = stats.hits + stats.misses;
+    out << "Compile cache " << directory << ": " << entries << " entries, " << bytes << " of " << maxBytes << " bytes\n";
+    out << "This run: " << stats.hits << " hits, " << stats.misses << " misses";
+    if (lookups != 0) {
+        out << " (" << stats.hits * 100 / lookups << "% hit rate)";
+    }
+    out << ", " << stats.stores << " stored, " << stats.evictions << " evicted, "
+    << stats.functionHits << " of " << stats.functionHits + stats.functionMisses << " functions reused\n";
+    out << "All runs: " << total.hits << " hits, " << total.misses << " misses, "
+    << total.stores << " stored, " << total.evictions << " evicted, "
+    << total.functionHits << " of " << total.functionHits + total.functionMisses << " functions reused\n";
+}
\ No newline at end of file
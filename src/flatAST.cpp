@@ -0,0 +1,251 @@
+#include <string>
+#include <vector>
+#include "flatAST.hpp"
+
+void FlatAST::build(const ProgramRoot* programRoot) {
+    uint32_t start = size();
+    uint32_t listStart = flattenList(programRoot->programElements);
+    root = addNode(NodeType::ProgramRoot,start);
+    first[root] = listStart;
+    second[root] = programRoot->programElements.size();
+}
+
+void FlatAST::reserve(size_t nodes) {
+    kinds.reserve(nodes);
+    ops.reserve(nodes);
+    flags.reserve(nodes);
+    first.reserve(nodes);
+    second.reserve(nodes);
+    third.reserve(nodes);
+    text.reserve(nodes);
+    values.reserve(nodes);
+    subtreeStart.reserve(nodes);
+    lists.reserve(nodes);
+}
+
+size_t FlatAST::memoryBytes() const {
+    size_t perNode = sizeof(NodeType) + sizeof(FlatOp) + sizeof(uint8_t) + 5 * sizeof(uint32_t) + sizeof(uint64_t);
+    return size() * perNode + lists.size() * sizeof(uint32_t);
+}
+
+FlatOp FlatAST::opFromString(const std::string& op) {
+    if (op == "+") return FlatOp::Add;
+    if (op == "-") return FlatOp::Sub;
+    if (op == "*") return FlatOp::Mul;
+    if (op == "/") return FlatOp::Div;
+    if (op == "%") return FlatOp::Mod;
+    if (op == "<<") return FlatOp::Shl;
+    if (op == ">>") return FlatOp::Shr;
+    if (op == "==") return FlatOp::Equal;
+    if (op == "!=") return FlatOp::NotEqual;
+    if (op == ">") return FlatOp::Greater;
+    if (op == "<") return FlatOp::Less;
+    if (op == ">=") return FlatOp::GreaterEqual;
+    if (op == "<=") return FlatOp::LessEqual;
+    if (op == "&") return FlatOp::AddressOf;
+    return FlatOp::None;
+}
+
+uint32_t FlatAST::addNode(NodeType kind, uint32_t start) {
+    uint32_t index = size();
+    kinds.push_back(kind);
+    ops.push_back(FlatOp::None);
+    flags.push_back(0);
+    first.push_back(NONE);
+    second.push_back(NONE);
+    third.push_back(NONE);
+    text.push_back(0);
+    values.push_back(0);
+    subtreeStart.push_back(start);
+    return index;
+}
+
+uint32_t FlatAST::flattenList(const std::vector<ASTNode*>& nodes, size_t maxCount) {
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < nodes.size() && i < maxCount; ++i) {
+        if (nodes[i] != nullptr) {
+            indices.push_back(flatten(nodes[i]));
+        }
+    }
+    uint32_t listStart = lists.size(); // after the children, they may add lists of their own
+    lists.insert(lists.end(),indices.begin(),indices.end());
+    return listStart;
+}
+
+uint32_t FlatAST::flatten(const ASTNode* node) {
+    uint32_t start = size();
+    uint32_t index = NONE;
+    switch (node->type) {
+        case NodeType::Constant: {
+            const Constant* constant = (const Constant*)node;
+            index = addNode(NodeType::Constant,start);
+            if (constant->constantType == "string") {
+                flags[index] = STRING_CONSTANT;
+                text[index] = strings.intern(constant->value);
+            }
+            else {
+                values[index] = std::stoll(constant->value);
+            }
+            break;
+        }
+        case NodeType::Identifier: {
+            index = addNode(NodeType::Identifier,start);
+            text[index] = strings.intern(((const Identifier*)node)->name);
+            break;
+        }
+        case NodeType::BinaryExpression: {
+            const BinaryExpression* binExpr = (const BinaryExpression*)node;
+            uint32_t right = flatten(binExpr->right);
+            uint32_t left = flatten(binExpr->left);
+            index = addNode(NodeType::BinaryExpression,start);
+            ops[index] = binExpr->op == "&" ? FlatOp::And : opFromString(binExpr->op); // "&" alone is address of
+            first[index] = left;
+            second[index] = right;
+            break;
+        }
+        case NodeType::ComparisonExpression: {
+            const ComparisonExpression* compExpr = (const ComparisonExpression*)node;
+            uint32_t left = flatten(compExpr->left);
+            uint32_t right = flatten(compExpr->right);
+            index = addNode(NodeType::ComparisonExpression,start);
+            ops[index] = opFromString(compExpr->op);
+            first[index] = left;
+            second[index] = right;
+            break;
+        }
+        case NodeType::UnaryExpression: {
+            const UnaryExpression* unaryExpr = (const UnaryExpression*)node;
+            FlatOp op = opFromString(unaryExpr->op);
+            if (op == FlatOp::AddressOf) { // &name, nothing to evaluate
+                index = addNode(NodeType::UnaryExpression,start);
+                if (unaryExpr->expression->type == NodeType::Identifier) {
+                    text[index] = strings.intern(((const Identifier*)unaryExpr->expression)->name);
+                }
+            }
+            else {
+                uint32_t operand = flatten(unaryExpr->expression);
+                index = addNode(NodeType::UnaryExpression,start);
+                first[index] = operand;
+                if (op == FlatOp::Mul) {
+                    op = FlatOp::Dereference;
+                }
+            }
+            ops[index] = op;
+            break;
+        }
+        case NodeType::ArrayAccess: {
+            const ArrayAccess* arrAccess = (const ArrayAccess*)node;
+            uint32_t array = flatten(arrAccess->array);
+            uint32_t arrIndex = flatten(arrAccess->index);
+            index = addNode(NodeType::ArrayAccess,start);
+            first[index] = array;
+            second[index] = arrIndex;
+            break;
+        }
+        case NodeType::PropertyAccess: {
+            const PropertyAccess* propAccess = (const PropertyAccess*)node;
+            uint32_t structNode = flatten(propAccess->Struct);
+            index = addNode(NodeType::PropertyAccess,start);
+            first[index] = structNode;
+            text[index] = strings.intern(propAccess->property);
+            break;
+        }
+        case NodeType::FunctionCall: {
+            const FunctionCall* funcCall = (const FunctionCall*)node;
+            uint32_t listStart = flattenList(funcCall->arguments,6); // register arguments only
+            index = addNode(NodeType::FunctionCall,start);
+            first[index] = listStart;
+            second[index] = lists.size() - listStart;
+            text[index] = strings.intern(funcCall->name);
+            break;
+        }
+        case NodeType::Assignment: {
+            const Assignment* assignment = (const Assignment*)node;
+            uint32_t target = flatten(assignment->identifier);
+            if (kinds[target] != NodeType::Identifier) {
+                flags[target] |= ADDRESS_ONLY;
+            }
+            uint32_t expression = flatten(assignment->expression);
+            index = addNode(NodeType::Assignment,start);
+            first[index] = target;
+            second[index] = expression;
+            break;
+        }
+        case NodeType::ReturnStatement: {
+            const ReturnStatement* returnStatement = (const ReturnStatement*)node;
+            uint32_t expression = NONE;
+            if (returnStatement->expression != nullptr) {
+                expression = flatten(returnStatement->expression);
+            }
+            index = addNode(NodeType::ReturnStatement,start);
+            first[index] = expression;
+            break;
+        }
+        case NodeType::VariableDeclaration: {
+            const VariableDeclaration* d = (const VariableDeclaration*)node;
+            index = addNode(NodeType::VariableDeclaration,start);
+            text[index] = strings.intern(d->varName);
+            third[index] = strings.intern(d->varType);
+            second[index] = d->pointerCount;
+            values[index] = d->localArrSize;
+            flags[index] = (d->isLocalArray ? LOCAL_ARRAY : 0) | (d->isStruct ? STRUCT : 0);
+            break;
+        }
+        case NodeType::CodeBlock: {
+            const CodeBlock* codeBlock = (const CodeBlock*)node;
+            uint32_t listStart = flattenList(codeBlock->statements);
+            index = addNode(NodeType::CodeBlock,start);
+            first[index] = listStart;
+            second[index] = lists.size() - listStart;
+            break;
+        }
+        case NodeType::IfStatement: {
+            const IfStatement* ifStatement = (const IfStatement*)node;
+            uint32_t expression = flatten(ifStatement->expression);
+            uint32_t codeBlock = flatten(ifStatement->codeBlock);
+            uint32_t elseBlock = NONE;
+            if (ifStatement->elseBlock != nullptr) {
+                elseBlock = flatten(ifStatement->elseBlock);
+            }
+            index = addNode(NodeType::IfStatement,start);
+            first[index] = expression;
+            second[index] = codeBlock;
+            third[index] = elseBlock;
+            break;
+        }
+        case NodeType::WhileStatement: {
+            const WhileStatement* whileStatement = (const WhileStatement*)node;
+            uint32_t expression = flatten(whileStatement->expression);
+            uint32_t codeBlock = flatten(whileStatement->codeBlock);
+            index = addNode(NodeType::WhileStatement,start);
+            first[index] = expression;
+            second[index] = codeBlock;
+            break;
+        }
+        case NodeType::Function: {
+            const Function* function = (const Function*)node;
+            uint32_t listStart = flattenList(function->parameters);
+            uint32_t codeBlock = flatten(function->codeBlock);
+            index = addNode(NodeType::Function,start);
+            first[index] = listStart;
+            second[index] = function->parameters.size();
+            third[index] = codeBlock;
+            text[index] = strings.intern(function->name);
+            values[index] = strings.intern(function->returnType);
+            break;
+        }
+        case NodeType::Struct: {
+            const Struct* structNode = (const Struct*)node;
+            uint32_t listStart = flattenList(structNode->properties);
+            index = addNode(NodeType::Struct,start);
+            first[index] = listStart;
+            second[index] = structNode->properties.size();
+            text[index] = strings.intern(structNode->name);
+            break;
+        }
+        default:
+            index = addNode(node->type,start);
+            break;
+    }
+    return index;
+}
\ No newline at end of file
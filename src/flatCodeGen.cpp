@@ -0,0 +1,378 @@
+#include <vector>
+#include <string>
+#include "flatAST.hpp"
+#include "CodeGen.hpp"
+
+// code generation from the FlatAST encoding. statements are walked through the
+// index lists, expressions by one linear pass over their node range
+
+bool CodeGen::generateObjectFile(const FlatAST& ast, const std::string filename) {
+    return writeObjectFile(generateText(ast),filename);
+}
+
+std::vector<uint8_t> CodeGen::generateText(const FlatAST& ast) {
+    std::vector<uint8_t> textData;
+    uint32_t start = ast.first[ast.root];
+    uint32_t end = start + ast.second[ast.root];
+    for (uint32_t i = start; i < end; ++i) {
+        uint32_t element = ast.lists[i];
+        if (ast.kinds[element] == NodeType::Function) {
+            std::vector<uint8_t> functionCode = generateCodeFromFlatFunction(ast,element);
+            addCode(textData,functionCode);
+        }
+        if (ast.kinds[element] == NodeType::Struct) {
+            addFlatStruct(ast,element);
+        }
+    }
+    return textData;
+}
+
+std::vector<uint8_t> CodeGen::generateCodeFromFlatFunction(const FlatAST& ast, uint32_t function) {
+    std::vector<uint8_t> code;
+    size_t relaStart = relaTextEntries.size();
+    size_t stringRelaStart = stringRelaEntries.size();
+    resetLabels();
+    uint32_t codeBlock = ast.third[function];
+    uint32_t paramStart = ast.first[function];
+    uint32_t paramCount = ast.second[function];
+
+    size_t varSizes = addFlatDeclarations(ast,paramStart,paramCount,0);
+    varSizes = addFlatDeclarations(ast,ast.first[codeBlock],ast.second[codeBlock],varSizes);
+    size_t pad = (16 - (varSizes % 16)) % 16; // pad to 16
+    startFunction(code);
+    if (varSizes > 0) {
+        subRsp(code,varSizes + pad);
+    }
+    uint32_t size = std::min(paramCount,(uint32_t)6);
+    for (uint32_t i = 0; i < size; ++i) {
+        const Variable* var = lookupVariable(ast.strings.get(ast.text[ast.lists[paramStart + i]]));
+        movRegReg(code,Reg::RAX,positionToRegister[i]);
+        movOffsetRbpReg(code,var->offset,Reg::RAX,var->getSize());
+    }
+
+    addFlatCodeBlockToCode(code,ast,codeBlock);
+
+    const std::string& name = ast.strings.get(ast.text[function]);
+    if (name == entryFunctionName) {
+        movImm(code,Reg::RAX,0);
+    }
+    leaveFunction(code);
+    resolveBranches(code,relaStart,stringRelaStart);
+
+    addFunctionSymbol(name,code.size());
+    return code;
+}
+
+size_t CodeGen::addFlatDeclarations(const FlatAST& ast, uint32_t listStart, uint32_t count, size_t varSizes) {
+    for (uint32_t i = listStart; i < listStart + count; ++i) {
+        uint32_t d = ast.lists[i];
+        if (ast.kinds[d] == NodeType::VariableDeclaration) {
+            varSizes = addVariable(ast.strings.get(ast.text[d]),ast.strings.get(ast.third[d]),ast.second[d],
+            ast.flags[d] & FlatAST::LOCAL_ARRAY,ast.values[d],ast.flags[d] & FlatAST::STRUCT,varSizes);
+        }
+    }
+    return varSizes;
+}
+
+void CodeGen::addFlatStruct(const FlatAST& ast, uint32_t structNode) {
+    const std::string& name = ast.strings.get(ast.text[structNode]);
+    size_t structSize = 0;
+    structOffsets[name] = new std::unordered_map<std::string,Variable*>();
+    std::unordered_map<std::string,Variable*>& offsets = (*structOffsets[name]);
+    uint32_t start = ast.first[structNode];
+    for (uint32_t i = start; i < start + ast.second[structNode]; ++i) {
+        uint32_t d = ast.lists[i];
+        const std::string& type = ast.strings.get(ast.third[d]);
+        offsets[ast.strings.get(ast.text[d])] = new Variable(structSize,type,typeSizes[type],ast.second[d],
+        ast.flags[d] & FlatAST::LOCAL_ARRAY,ast.values[d],ast.flags[d] & FlatAST::STRUCT);
+        structSize += getVarSize(type,ast.second[d]);
+    }
+    typeSizes[name] = structSize;
+}
+
+void CodeGen::addFlatCodeBlockToCode(std::vector<uint8_t>& code, const FlatAST& ast, uint32_t codeBlock) {
+    uint32_t start = ast.first[codeBlock];
+    uint32_t end = start + ast.second[codeBlock];
+    for (uint32_t i = start; i < end; ++i) {
+        uint32_t statement = ast.lists[i];
+        switch (ast.kinds[statement]) {
+            case NodeType::ReturnStatement:
+                if (ast.first[statement] != FlatAST::NONE) {
+                    addFlatExpressionToCode(code,ast,ast.first[statement]);
+                }
+                leaveFunction(code);
+                break;
+
+            case NodeType::FunctionCall:
+                addFlatExpressionToCode(code,ast,statement);
+                break;
+
+            case NodeType::Assignment: {
+                uint32_t target = ast.first[statement];
+                uint32_t expression = ast.second[statement];
+                if (ast.kinds[target] == NodeType::Identifier) {
+                    const Variable* var = lookupVariable(ast.strings.get(ast.text[target]));
+                    addFlatExpressionToCode(code,ast,expression);
+                    movOffsetRbpReg(code,var->offset,Reg::RAX,var->getSize());
+                }
+                else {
+                    // target address, then the value
+                    addFlatExpressionToCode(code,ast,target);
+                    flatPush(code,Reg::RAX);
+                    addFlatExpressionToCode(code,ast,expression);
+                    movRegReg(code,Reg::R11,Reg::RAX);
+                    flatPop(code,Reg::RAX);
+                    movPtrRegReg(code,{Reg::RAX},Reg::R11,flatAccessSize(ast,target));
+                }
+                break;
+            }
+
+            case NodeType::IfStatement: {
+                uint32_t expression = ast.first[statement];
+                bool isSigned = addFlatExpressionToCode(code,ast,expression) < 0;
+                uint32_t elseLabel = newLabel();
+                jccTo(code,oppositeCond(flatJumpCondition(ast.ops[expression],isSigned)),elseLabel);
+                addFlatCodeBlockToCode(code,ast,ast.second[statement]);
+                if (ast.third[statement] == FlatAST::NONE) {
+                    bindLabel(code,elseLabel);
+                    break;
+                }
+                uint32_t endLabel = newLabel();
+                jmpTo(code,endLabel);
+                bindLabel(code,elseLabel);
+                addFlatCodeBlockToCode(code,ast,ast.third[statement]);
+                bindLabel(code,endLabel);
+                break;
+            }
+
+            case NodeType::WhileStatement: {
+                uint32_t expression = ast.first[statement];
+                uint32_t bodyLabel = newLabel();
+                uint32_t conditionLabel = newLabel();
+                jmpTo(code,conditionLabel);
+                bindLabel(code,bodyLabel);
+                addFlatCodeBlockToCode(code,ast,ast.second[statement]);
+                bindLabel(code,conditionLabel);
+                bool isSigned = addFlatExpressionToCode(code,ast,expression) < 0;
+                jccTo(code,flatJumpCondition(ast.ops[expression],isSigned),bodyLabel);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+int CodeGen::addFlatExpressionToCode(std::vector<uint8_t>& code, const FlatAST& ast, uint32_t expression) {
+    // operands are the values produced right before a node: the newest one is
+    // kept in rax, the older ones are pushed. the result ends in rax.
+    // signs follows the values, as in expressionSign
+    size_t live = 0;
+    std::vector<int> signs;
+    auto combine = [&](size_t count, int sign) {
+        for (size_t i = 0; i < count; ++i) {
+            sign = combineSigns(sign,signs.back());
+            signs.pop_back();
+        }
+        signs.push_back(sign);
+    };
+    for (uint32_t node = ast.subtreeStart[expression]; node <= expression; ++node) {
+        switch (ast.kinds[node]) {
+            case NodeType::Constant:
+                if (live++ > 0) {
+                    flatPush(code,Reg::RAX);
+                }
+                if (ast.flags[node] & FlatAST::STRING_CONSTANT) {
+                    addConstantStringToRegToCode(code,ast.strings.get(ast.text[node]),Reg::RAX);
+                    signs.push_back(1);
+                }
+                else {
+                    movImm(code,Reg::RAX,ast.values[node]);
+                    signs.push_back(0);
+                }
+                break;
+
+            case NodeType::Identifier: {
+                if (live++ > 0) {
+                    flatPush(code,Reg::RAX);
+                }
+                const Variable* var = lookupVariable(ast.strings.get(ast.text[node]));
+                if (var->isLocalArr || var->isStruct) {
+                    leaRegOffsetRbp(code,Reg::RAX,var->offset);
+                }
+                else {
+                    loadRegMem(code,Reg::RAX,{Reg::RBP,-(int32_t)var->offset},var->getSize(),var->isSigned());
+                }
+                signs.push_back(var->isSigned() ? -1 : 1);
+                break;
+            }
+
+            case NodeType::UnaryExpression:
+                if (ast.ops[node] == FlatOp::AddressOf && ast.text[node] != 0) {
+                    if (live++ > 0) {
+                        flatPush(code,Reg::RAX);
+                    }
+                    const Variable* var = lookupVariable(ast.strings.get(ast.text[node]));
+                    leaRegOffsetRbp(code,Reg::RAX,var->offset);
+                    signs.push_back(1);
+                }
+                else if (ast.ops[node] == FlatOp::Dereference) {
+                    movRegPtrReg(code,Reg::RAX,Reg::RAX);
+                    combine(1,0); // the pointed to type isn't kept
+                }
+                break;
+
+            case NodeType::BinaryExpression: // rax = left, right on the stack
+                flatPop(code,Reg::R11);
+                --live;
+                combine(2,0);
+                switch (ast.ops[node]) {
+                    case FlatOp::Add:
+                        addRegReg(code,Reg::RAX,Reg::R11);
+                        break;
+                    case FlatOp::Sub:
+                        subRegReg(code,Reg::RAX,Reg::R11);
+                        break;
+                    case FlatOp::Mul:
+                        imulRegReg(code,Reg::RAX,Reg::R11);
+                        break;
+                    case FlatOp::Div:
+                    case FlatOp::Mod:
+                        if (signs.back() < 0) {
+                            cqo(code);
+                            idivReg(code,Reg::R11);
+                        }
+                        else {
+                            movImm(code,Reg::RDX,0);
+                            divReg(code,Reg::R11,8);
+                        }
+                        if (ast.ops[node] == FlatOp::Mod) {
+                            movRegReg(code,Reg::RAX,Reg::RDX);
+                        }
+                        break;
+                    case FlatOp::Shl:
+                        shlRegImm(code,Reg::RAX,ast.values[ast.second[node]]);
+                        break;
+                    case FlatOp::Shr:
+                        shrRegImm(code,Reg::RAX,ast.values[ast.second[node]]);
+                        break;
+                    case FlatOp::And:
+                        andRegImm(code,Reg::RAX,ast.values[ast.second[node]]);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+
+            case NodeType::ComparisonExpression: // rax = right, left on the stack
+                movRegReg(code,Reg::R11,Reg::RAX);
+                flatPop(code,Reg::RAX);
+                cmpRegReg(code,Reg::RAX,Reg::R11);
+                live -= 2;
+                combine(2,0);
+                break;
+
+            case NodeType::ArrayAccess: { // rax = index, array address on the stack
+                const Variable* var = lookupVariable(ast.strings.get(ast.text[ast.first[node]]));
+                uint8_t sizeOfElement = var->getElementSize();
+                MemOperand element{Reg::R11,0,Reg::RAX,sizeOfElement};
+                if (sizeOfElement != 1 && sizeOfElement != 2 && sizeOfElement != 4 && sizeOfElement != 8) { // no such scale
+                    imulRegImm(code,Reg::RAX,Reg::RAX,sizeOfElement);
+                    element.scale = 1;
+                }
+                flatPop(code,Reg::R11);
+                --live;
+                signs.pop_back();
+                signs.back() = var->isElementSigned() ? -1 : 1;
+                if (ast.flags[node] & FlatAST::ADDRESS_ONLY) {
+                    leaRegMem(code,Reg::RAX,element);
+                }
+                else {
+                    loadRegMem(code,Reg::RAX,element,sizeOfElement,var->isElementSigned());
+                }
+                break;
+            }
+
+            case NodeType::PropertyAccess: { // rax = struct address
+                const Variable* var = lookupVariable(ast.strings.get(ast.text[ast.first[node]]));
+                const Variable* structVar = lookupField(var,ast.strings.get(ast.text[node]));
+                signs.back() = structVar->isSigned() ? -1 : 1;
+                if (!(ast.flags[node] & FlatAST::ADDRESS_ONLY)) { // the field offset is the displacement
+                    loadRegMem(code,Reg::RAX,{Reg::RAX,(int32_t)structVar->offset},structVar->getSize(),structVar->isSigned());
+                }
+                else if (structVar->offset > 0) { // optimization, skipping adding 0
+                    addRegImm(code,Reg::RAX,structVar->offset);
+                }
+                break;
+            }
+
+            case NodeType::FunctionCall: { // arguments are the last count values
+                uint32_t count = ast.second[node];
+                if (count > 0) {
+                    flatPush(code,Reg::RAX);
+                    for (uint32_t i = count; i > 0; --i) {
+                        flatPop(code,positionToRegister[i-1]);
+                    }
+                }
+                else if (live > 0) {
+                    flatPush(code,Reg::RAX);
+                }
+                live = live - count + 1;
+                signs.resize(signs.size() - count);
+                signs.push_back(0);
+
+                bool misaligned = (flatPushed % 2) != 0; // rsp has to be 16 byte aligned at the call
+                if (misaligned) {
+                    subRsp(code,8);
+                }
+                movImm(code,Reg::RAX,0); // al, no vector registers for variadic callees
+
+                Elf64_Rela rel{};
+                rel.r_offset = currentFunctionOffset + code.size() + 1;
+                rel.r_addend = -4; // constant
+                relaTextEntries.push_back(rel);
+                relaFuncStrings.push_back(ast.strings.get(ast.text[node]));
+                call(code);
+                if (misaligned) {
+                    addRegImm(code,Reg::RSP,8);
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+    return signs.empty() ? 0 : signs.back();
+}
+
+// the values pushed by the flat generator are counted, calls need to know the alignment
+void CodeGen::flatPush(std::vector<uint8_t>& code, Reg reg) {
+    pushReg(code,reg);
+    ++flatPushed;
+}
+
+void CodeGen::flatPop(std::vector<uint8_t>& code, Reg reg) {
+    popReg(code,reg);
+    --flatPushed;
+}
+
+uint8_t CodeGen::flatAccessSize(const FlatAST& ast, uint32_t target) {
+    const Variable* var = lookupVariable(ast.strings.get(ast.text[ast.first[target]]));
+    if (ast.kinds[target] == NodeType::PropertyAccess) {
+        return lookupField(var,ast.strings.get(ast.text[target]))->getSize();
+    }
+    return var->getElementSize();
+}
+
+Cond CodeGen::flatJumpCondition(FlatOp op, bool isSigned) {
+    switch (op) {
+        case FlatOp::Equal: return Cond::E;
+        case FlatOp::NotEqual: return Cond::NE;
+        case FlatOp::Greater: return isSigned ? Cond::G : Cond::A;
+        case FlatOp::Less: return isSigned ? Cond::L : Cond::B;
+        case FlatOp::GreaterEqual: return isSigned ? Cond::GE : Cond::AE;
+        default: return isSigned ? Cond::LE : Cond::BE;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include "ASTnode.hpp"
+#include "CodeGen.hpp"
+#include "hash.hpp"
+
+// everything the code of a function depends on: its tokens, the options, and
+// the layouts of the structs it names, along with the structs inside those
+std::string CodeGen::functionFingerprint(const Function* function) {
+    Hash128 hash;
+    hash.add(function->tokenHash);
+    hash.add((uint64_t)promoteLocals);
+    hash.add((uint64_t)useIR);
+    hash.add(entryFunctionName);
+
+    std::vector<std::string> structs = function->structsUsed;
+    for (size_t i = 0; i < structs.size(); ++i) {
+        const std::string& name = structs[i];
+        hash.add(name);
+        if (structOffsets.find(name) == structOffsets.end()) {
+            continue;
+        }
+        hash.add((uint64_t)typeSizes[name]);
+        std::vector<std::pair<std::string,const Variable*>> properties(structOffsets[name]->begin(),structOffsets[name]->end());
+        std::sort(properties.begin(),properties.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& [property, var] : properties) {
+            hash.add(property);
+            hash.add(var->type);
+            hash.add((uint64_t)var->offset);
+            hash.add((uint64_t)var->typeSize);
+            hash.add((uint64_t)var->pointerCount);
+            hash.add((uint64_t)var->isLocalArr);
+            hash.add((uint64_t)var->localArrSize);
+            if (var->isStruct && std::find(structs.begin(),structs.end(),var->type) == structs.end()) {
+                structs.push_back(var->type);
+            }
+        }
+    }
+    return hash.hex();
+}
+
+template <typename T>
+static void saveVector(std::string& data, const std::vector<T>& values) {
+    uint64_t count = values.size();
+    data.append((const char*)&count,sizeof(count));
+    data.append((const char*)values.data(),count * sizeof(T));
+}
+
+static void saveString(std::string& data, const std::string& value) {
+    uint64_t size = value.size();
+    data.append((const char*)&size,sizeof(size));
+    data += value;
+}
+
+template <typename T>
+static bool loadVector(const std::string& data, size_t& position, std::vector<T>& values) {
+    uint64_t count;
+    if (data.size() - position < sizeof(count)) {
+        return false;
+    }
+    memcpy(&count,data.data() + position,sizeof(count));
+    position += sizeof(count);
+    if ((data.size() - position) / sizeof(T) < count) {
+        return false;
+    }
+    values.resize(count);
+    memcpy(values.data(),data.data() + position,count * sizeof(T));
+    position += count * sizeof(T);
+    return true;
+}
+
+static bool loadString(const std::string& data, size_t& position, std::string& value) {
+    std::vector<char> bytes;
+    if (!loadVector(data,position,bytes)) {
+        return false;
+    }
+    value.assign(bytes.begin(),bytes.end());
+    return true;
+}
+
+// the state a worker leaves for mergeFunction, after generating one function
+std::string CodeGen::saveFunction(const std::vector<uint8_t>& code) const {
+    std::string data;
+    saveVector(data,code);
+    saveVector(data,relaTextEntries);
+    saveVector(data,stringRelaEntries);
+    saveVector(data,stringRelaStrings);
+    saveVector(data,functionSymbols);
+    for (const std::vector<std::string>* names : {&relaFuncStrings,&functionSymbolNames,&poolStrings}) {
+        saveVector(data,std::vector<uint64_t>{names->size()});
+        for (const std::string& name : *names) {
+            saveString(data,name);
+        }
+    }
+    const FunctionSize& size = functionSizes.back();
+    saveString(data,size.name);
+    saveVector(data,std::vector<uint64_t>{size.codeBytes,size.frameBytes});
+    return data;
+}
+
+// the other way around, into a fresh worker. false if the entry is damaged
+bool CodeGen::loadFunction(const std::string& data, std::vector<uint8_t>& code) {
+    size_t position = 0;
+    std::vector<uint64_t> counts;
+    if (!loadVector(data,position,code)
+        || !loadVector(data,position,relaTextEntries)
+        || !loadVector(data,position,stringRelaEntries)
+        || !loadVector(data,position,stringRelaStrings)
+        || !loadVector(data,position,functionSymbols)) {
+        return false;
+    }
+    for (std::vector<std::string>* names : {&relaFuncStrings,&functionSymbolNames,&poolStrings}) {
+        if (!loadVector(data,position,counts) || counts.size() != 1 || counts[0] > data.size()) {
+            return false;
+        }
+        names->resize(counts[0]);
+        for (std::string& name : *names) {
+            if (!loadString(data,position,name)) {
+                return false;
+            }
+        }
+    }
+    FunctionSize size;
+    if (!loadString(data,position,size.name) || !loadVector(data,position,counts) || counts.size() != 2
+        || position != data.size() || functionSymbolNames.size() != functionSymbols.size()
+        || relaFuncStrings.size() != relaTextEntries.size() || stringRelaStrings.size() != stringRelaEntries.size()) {
+        return false;
+    }
+    for (uint32_t string : stringRelaStrings) {
+        if (string >= poolStrings.size()) {
+            return false;
+        }
+    }
+    size.codeBytes = counts[0];
+    size.frameBytes = counts[1];
+    functionSizes.push_back(size);
+    return true;
+}
\ No newline at end of file
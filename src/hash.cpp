@@ -0,0 +1,39 @@
+#include "hash.hpp"
+
+// the 128 bit FNV prime is 2^88 + 0x13B
+static const uint64_t fnvPrimeLow = 0x13B;
+static const unsigned fnvPrimeShift = 88 - 64;
+
+void Hash128::addByte(uint8_t byte) {
+    low ^= byte;
+    // (high, low) * prime, mod 2^128. low * 0x13B is split in 32 bit halves for its upper word
+    uint64_t lowProduct = (low & 0xFFFFFFFF) * fnvPrimeLow;
+    uint64_t highProduct = (low >> 32) * fnvPrimeLow;
+    uint64_t product = lowProduct + (highProduct << 32);
+    uint64_t carry = (product < lowProduct) ? 1 : 0;
+    high = high * fnvPrimeLow + (highProduct >> 32) + carry + (low << fnvPrimeShift);
+    low = product;
+}
+
+void Hash128::add(std::string_view bytes) {
+    for (unsigned char byte : bytes) {
+        addByte(byte);
+    }
+    add((uint64_t)bytes.size());
+}
+
+void Hash128::add(uint64_t value) {
+    for (size_t i = 0; i < 8; ++i, value >>= 8) {
+        addByte(value & 0xFF);
+    }
+}
+
+std::string Hash128::hex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(32,'0');
+    for (size_t i = 0; i < 16; ++i) {
+        text[15 - i] = digits[(high >> (4 * i)) & 0xF];
+        text[31 - i] = digits[(low >> (4 * i)) & 0xF];
+    }
+    return text;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <string>
+#include "ir.hpp"
+
+static const char* opName(IROp op) {
+    switch (op) {
+        case IROp::Const: return "const";
+        case IROp::String: return "string";
+        case IROp::Param: return "param";
+        case IROp::Phi: return "phi";
+        case IROp::Add: return "add";
+        case IROp::Sub: return "sub";
+        case IROp::Mul: return "mul";
+        case IROp::Div: return "div";
+        case IROp::Mod: return "mod";
+        case IROp::Shl: return "shl";
+        case IROp::Shr: return "shr";
+        case IROp::And: return "and";
+        case IROp::Truncate: return "trunc";
+        case IROp::SlotAddr: return "slot";
+        case IROp::Load: return "load";
+        case IROp::Store: return "store";
+        case IROp::Call: return "call";
+        case IROp::Jump: return "jump";
+        case IROp::Branch: return "branch";
+        case IROp::Return: return "return";
+    }
+    return "?";
+}
+
+static const char* condName(Cond cond) {
+    switch (cond) {
+        case Cond::E: return "==";
+        case Cond::NE: return "!=";
+        case Cond::B: return "<u";
+        case Cond::AE: return ">=u";
+        case Cond::BE: return "<=u";
+        case Cond::A: return ">u";
+        case Cond::L: return "<";
+        case Cond::GE: return ">=";
+        case Cond::LE: return "<=";
+        case Cond::G: return ">";
+    }
+    return "?";
+}
+
+void IRFunction::print(std::ostream& out) const {
+    out << "function " << name << " (frame " << frameSize << ")\n";
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const IRBlock& block = blocks[b];
+        out << "b" << b << ":";
+        if (!block.preds.empty()) {
+            out << " ; preds";
+            for (uint32_t pred : block.preds) {
+                out << " b" << pred;
+            }
+        }
+        out << "\n";
+        for (uint32_t v : block.instrs) {
+            const IRInstr& instr = values[v];
+            if (instr.removed) {
+                continue;
+            }
+            out << "    ";
+            if (hasResult(instr.op)) {
+                out << "v" << v << " = ";
+            }
+            if (instr.isSigned) {
+                out << "s"; // sdiv, sload4...
+            }
+            out << opName(instr.op);
+            if (instr.op == IROp::Load || instr.op == IROp::Store || instr.op == IROp::Truncate) {
+                out << (int)instr.size;
+            }
+            switch (instr.op) {
+                case IROp::Const:
+                case IROp::Param:
+                case IROp::SlotAddr:
+                    out << " " << instr.imm;
+                    break;
+                case IROp::String:
+                    out << " \"" << instr.text << "\"";
+                    break;
+                case IROp::Call:
+                    out << " " << instr.text;
+                    break;
+                default:
+                    break;
+            }
+            if (instr.op == IROp::Branch) {
+                out << " v" << instr.operands[0] << " " << condName(instr.cond) << " v" << instr.operands[1];
+            }
+            else {
+                for (size_t i = 0; i < instr.operands.size(); ++i) {
+                    out << (i == 0 ? " " : ", ") << "v" << instr.operands[i];
+                }
+                if (instr.op == IROp::Shl || instr.op == IROp::Shr || instr.op == IROp::And) {
+                    out << ", " << instr.imm;
+                }
+                else if ((instr.op == IROp::Load || instr.op == IROp::Store) && instr.imm != 0) {
+                    out << " +" << instr.imm; // displacement
+                }
+            }
+            for (size_t i = 0; i < block.succs.size() && IRFunction::isTerminator(instr.op); ++i) {
+                out << (i == 0 ? " -> b" : ", b") << block.succs[i];
+            }
+            out << "\n";
+        }
+    }
+}
\ No newline at end of file
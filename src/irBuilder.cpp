@@ -0,0 +1,516 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "ASTnode.hpp"
+#include "ir.hpp"
+#include "CodeGen.hpp"
+
+// AST to SSA, built on the fly: every block keeps the current value of each
+// variable, reads in blocks whose predecessors aren't all known yet (loop
+// headers) get a phi that is completed once the block is sealed.
+// arrays, structs and address-taken locals stay in stack slots
+
+IRFunction CodeGen::buildIRFunction(Function* function) {
+    IRFunction irFunction;
+    irFunction.name = function->name;
+    ir = IRBuildState();
+    ir.function = &irFunction;
+
+    // scalars whose address is never taken only live as values
+    std::unordered_map<std::string,LiveInterval> intervals;
+    std::unordered_set<std::string> addressTaken;
+    size_t position = 0;
+    collectLiveIntervals(function->codeBlock,position,intervals,addressTaken);
+    promotedLocals.clear();
+    for (const std::vector<ASTNode*>* declarations : {&function->parameters,&function->codeBlock->statements}) {
+        for (ASTNode* node : *declarations) {
+            if (node->type != NodeType::VariableDeclaration) {
+                continue;
+            }
+            VariableDeclaration* d = (VariableDeclaration*)node;
+            if (!d->isLocalArray && !(d->isStruct && d->pointerCount == 0) && !addressTaken.count(d->varName)) {
+                promotedLocals[d->varName] = Reg::RAX; // no register yet, just keeps it off the stack
+            }
+        }
+    }
+    size_t varSizes = addDeclarations(function->parameters,0);
+    irFunction.frameSize = addDeclarations(function->codeBlock->statements,varSizes);
+
+    irEnterBlock(irNewBlock());
+    irSeal(0);
+    size_t paramCount = std::min(function->parameters.size(),(size_t)6);
+    std::vector<uint32_t> params;
+    for (size_t i = 0; i < paramCount; ++i) { // all parameters first, they arrive together
+        params.push_back(irAdd(IROp::Param,{},i));
+    }
+    for (size_t i = 0; i < paramCount; ++i) {
+        const std::string& name = ((VariableDeclaration*)function->parameters[i])->varName;
+        const Variable* var = lookupVariable(name);
+        uint32_t value = params[i];
+        if (var->inRegister) {
+            if (var->getSize() < 8) {
+                value = irAdd(IROp::Truncate,{value},0,var->getSize(),var->isSigned());
+            }
+            irWriteVariable(name,ir.block,value);
+        }
+        else {
+            irAdd(IROp::Store,{irAdd(IROp::SlotAddr,{},var->offset),value},0,var->getSize());
+        }
+    }
+
+    irCodeBlock(function->codeBlock);
+    if (!irTerminated() && irReachable(ir.block)) {
+        if (function->name == entryFunctionName) {
+            irAdd(IROp::Return,{irAdd(IROp::Const,{},0)});
+        }
+        else {
+            irAdd(IROp::Return);
+        }
+    }
+    irApplyLayout();
+    irRemoveTrivialPhis();
+    variableNameToObject.clear();
+    return irFunction;
+}
+
+uint32_t CodeGen::irAdd(IROp op, std::vector<uint32_t> operands, uint64_t imm, uint8_t size, bool isSigned) {
+    IRInstr instr;
+    instr.op = op;
+    instr.imm = imm;
+    instr.size = size;
+    instr.isSigned = isSigned;
+    instr.operands = std::move(operands);
+    ir.function->values.push_back(std::move(instr));
+    uint32_t value = ir.function->values.size() - 1;
+    ir.function->blocks[ir.block].instrs.push_back(value);
+    return value;
+}
+
+uint32_t CodeGen::irNewBlock() {
+    ir.function->blocks.emplace_back();
+    ir.definitions.emplace_back();
+    ir.sealed.push_back(false);
+    ir.incompletePhis.emplace_back();
+    return ir.function->blocks.size() - 1;
+}
+
+void CodeGen::irEnterBlock(uint32_t block) {
+    ir.block = block;
+    ir.layout.push_back(block);
+}
+
+void CodeGen::irAddEdge(uint32_t from, uint32_t to) {
+    ir.function->blocks[from].succs.push_back(to);
+    ir.function->blocks[to].preds.push_back(from);
+}
+
+void CodeGen::irJump(uint32_t target) {
+    if (irTerminated() || !irReachable(ir.block)) {
+        return;
+    }
+    irAdd(IROp::Jump);
+    irAddEdge(ir.block,target);
+}
+
+void CodeGen::irSeal(uint32_t block) {
+    for (const auto& [name, phi] : ir.incompletePhis[block]) {
+        irAddPhiOperands(name,phi,block);
+    }
+    ir.incompletePhis[block].clear();
+    ir.sealed[block] = true;
+}
+
+bool CodeGen::irReachable(uint32_t block) {
+    return block == 0 || !ir.function->blocks[block].preds.empty();
+}
+
+bool CodeGen::irTerminated() {
+    const std::vector<uint32_t>& instrs = ir.function->blocks[ir.block].instrs;
+    return !instrs.empty() && IRFunction::isTerminator(ir.function->values[instrs.back()].op);
+}
+
+void CodeGen::irWriteVariable(const std::string& name, uint32_t block, uint32_t value) {
+    ir.definitions[block][name] = value;
+}
+
+uint32_t CodeGen::irReadVariable(const std::string& name, uint32_t block) {
+    auto found = ir.definitions[block].find(name);
+    if (found != ir.definitions[block].end()) {
+        return found->second;
+    }
+    uint32_t value;
+    const std::vector<uint32_t>& preds = ir.function->blocks[block].preds;
+    if (!ir.sealed[block]) {
+        value = irAddPhi(block);
+        ir.incompletePhis[block].push_back({name,value});
+    }
+    else if (preds.size() == 1) {
+        value = irReadVariable(name,preds[0]);
+    }
+    else if (preds.empty()) { // read before any assignment
+        value = irUndefined();
+    }
+    else {
+        value = irAddPhi(block);
+        irWriteVariable(name,block,value); // breaks cycles through loops
+        irAddPhiOperands(name,value,block);
+    }
+    irWriteVariable(name,block,value);
+    return value;
+}
+
+uint32_t CodeGen::irAddPhi(uint32_t block) {
+    IRInstr phi;
+    phi.op = IROp::Phi;
+    ir.function->values.push_back(std::move(phi));
+    uint32_t value = ir.function->values.size() - 1;
+    std::vector<uint32_t>& instrs = ir.function->blocks[block].instrs;
+    size_t at = 0;
+    while (at < instrs.size() && ir.function->values[instrs[at]].op == IROp::Phi) {
+        ++at;
+    }
+    instrs.insert(instrs.begin() + at,value);
+    return value;
+}
+
+void CodeGen::irAddPhiOperands(const std::string& name, uint32_t phi, uint32_t block) {
+    for (size_t i = 0; i < ir.function->blocks[block].preds.size(); ++i) {
+        uint32_t operand = irReadVariable(name,ir.function->blocks[block].preds[i]);
+        ir.function->values[phi].operands.push_back(operand);
+    }
+}
+
+uint32_t CodeGen::irUndefined() {
+    if (ir.undefined == UINT32_MAX) { // a zero after the parameters of the entry block
+        IRInstr zero;
+        zero.op = IROp::Const;
+        ir.function->values.push_back(std::move(zero));
+        ir.undefined = ir.function->values.size() - 1;
+        std::vector<uint32_t>& instrs = ir.function->blocks[0].instrs;
+        size_t at = 0;
+        while (at < instrs.size() && ir.function->values[instrs[at]].op == IROp::Param) {
+            ++at;
+        }
+        instrs.insert(instrs.begin() + at,ir.undefined);
+    }
+    return ir.undefined;
+}
+
+// a phi whose operands are all one value (or itself) is that value
+void CodeGen::irRemoveTrivialPhis() {
+    std::vector<IRInstr>& values = ir.function->values;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t v = 0; v < values.size(); ++v) {
+            if (values[v].op != IROp::Phi || values[v].removed) {
+                continue;
+            }
+            uint32_t same = UINT32_MAX;
+            bool trivial = true;
+            for (uint32_t operand : values[v].operands) {
+                if (operand == v || operand == same) {
+                    continue;
+                }
+                if (same != UINT32_MAX) {
+                    trivial = false;
+                    break;
+                }
+                same = operand;
+            }
+            if (!trivial) {
+                continue;
+            }
+            if (same == UINT32_MAX) {
+                same = irUndefined();
+            }
+            for (IRInstr& instr : values) {
+                std::replace(instr.operands.begin(),instr.operands.end(),v,same);
+            }
+            values[v].removed = true;
+            changed = true;
+        }
+    }
+    for (IRBlock& block : ir.function->blocks) {
+        block.instrs.erase(std::remove_if(block.instrs.begin(),block.instrs.end(),[&](uint32_t v) {
+            return values[v].removed;
+        }),block.instrs.end());
+    }
+}
+
+// renumbers the blocks so index order is the order they were entered in,
+// loop headers come after their bodies. unreachable blocks are dropped
+void CodeGen::irApplyLayout() {
+    std::vector<IRBlock>& blocks = ir.function->blocks;
+    std::vector<bool> reachable(blocks.size(),false);
+    std::vector<uint32_t> stack = {0};
+    reachable[0] = true;
+    while (!stack.empty()) {
+        uint32_t block = stack.back();
+        stack.pop_back();
+        for (uint32_t succ : blocks[block].succs) {
+            if (!reachable[succ]) {
+                reachable[succ] = true;
+                stack.push_back(succ);
+            }
+        }
+    }
+    std::vector<uint32_t> newIndex(blocks.size(),UINT32_MAX);
+    std::vector<IRBlock> reordered;
+    for (uint32_t block : ir.layout) {
+        if (reachable[block] && newIndex[block] == UINT32_MAX) {
+            newIndex[block] = reordered.size();
+            reordered.push_back(std::move(blocks[block]));
+        }
+    }
+    for (IRBlock& block : reordered) {
+        // edges from dropped blocks go, with their phi operands
+        std::vector<uint32_t> preds;
+        for (size_t i = 0; i < block.preds.size(); ++i) {
+            if (!reachable[block.preds[i]]) {
+                for (uint32_t v : block.instrs) {
+                    if (ir.function->values[v].op == IROp::Phi) {
+                        ir.function->values[v].operands[i] = UINT32_MAX;
+                    }
+                }
+                continue;
+            }
+            preds.push_back(newIndex[block.preds[i]]);
+        }
+        block.preds = std::move(preds);
+        for (uint32_t v : block.instrs) {
+            std::vector<uint32_t>& operands = ir.function->values[v].operands;
+            if (ir.function->values[v].op == IROp::Phi) {
+                operands.erase(std::remove(operands.begin(),operands.end(),UINT32_MAX),operands.end());
+            }
+        }
+        for (uint32_t& succ : block.succs) {
+            succ = newIndex[succ];
+        }
+    }
+    blocks = std::move(reordered);
+}
+
+// sign is set to the sign of the value, as expressionSign would give it
+uint32_t CodeGen::irExpression(ASTNode* expression, int& sign) {
+    sign = 0;
+    switch (expression->type) {
+        case NodeType::Constant: {
+            Constant* constant = (Constant*)expression;
+            if (constant->constantType == "string") {
+                sign = 1;
+                uint32_t value = irAdd(IROp::String);
+                ir.function->values[value].text = constant->value;
+                return value;
+            }
+            return irAdd(IROp::Const,{},std::stoull(constant->value));
+        }
+        case NodeType::Identifier: {
+            Identifier* identifier = (Identifier*)expression;
+            const Variable* var = lookupVariable(identifier->name);
+            sign = var->isSigned() ? -1 : 1;
+            if (var->inRegister) {
+                return irReadVariable(identifier->name,ir.block);
+            }
+            uint32_t slot = irAdd(IROp::SlotAddr,{},var->offset);
+            if (var->isLocalArr || var->isStruct) {
+                return slot;
+            }
+            return irAdd(IROp::Load,{slot},0,var->getSize(),var->isSigned());
+        }
+        case NodeType::ArrayAccess:
+        case NodeType::PropertyAccess: {
+            uint8_t size;
+            uint64_t disp;
+            std::vector<uint32_t> address = irAddress(expression,size,disp);
+            sign = expressionSign(expression);
+            return irAdd(IROp::Load,std::move(address),disp,size,sign < 0);
+        }
+        case NodeType::FunctionCall: {
+            FunctionCall* functionCall = (FunctionCall*)expression;
+            std::vector<uint32_t> args;
+            for (size_t i = 0; i < std::min(functionCall->arguments.size(),(size_t)6); ++i) {
+                args.push_back(irExpression(functionCall->arguments[i]));
+            }
+            uint32_t value = irAdd(IROp::Call,std::move(args));
+            ir.function->values[value].text = functionCall->name;
+            return value;
+        }
+        case NodeType::UnaryExpression: {
+            UnaryExpression* unaryExpr = (UnaryExpression*)expression;
+            sign = 1; // an address
+            if (unaryExpr->op == "&" && unaryExpr->expression->type == NodeType::Identifier) {
+                const Variable* var = lookupVariable(((Identifier*)unaryExpr->expression)->name);
+                return irAdd(IROp::SlotAddr,{},var->offset);
+            }
+            if (unaryExpr->op == "*") {
+                uint8_t size = 8;
+                if (unaryExpr->expression->type == NodeType::Identifier) {
+                    size = lookupVariable(((Identifier*)unaryExpr->expression)->name)->getElementSize();
+                }
+                uint32_t address = irExpression(unaryExpr->expression);
+                sign = expressionSign(expression);
+                return irAdd(IROp::Load,{address},0,size,sign < 0);
+            }
+            break;
+        }
+        case NodeType::BinaryExpression: {
+            BinaryExpression* binExpr = (BinaryExpression*)expression;
+            const std::string& op = binExpr->op;
+            if (op == "<<" || op == ">>" || op == "&") { // the right side is a constant
+                IROp irOp = op == "<<" ? IROp::Shl : op == ">>" ? IROp::Shr : IROp::And;
+                return irAdd(irOp,{irExpression(binExpr->left,sign)},std::stoull(((Constant*)binExpr->right)->value));
+            }
+            int rightSign;
+            uint32_t left = irExpression(binExpr->left,sign);
+            uint32_t right = irExpression(binExpr->right,rightSign);
+            sign = combineSigns(sign,rightSign);
+            IROp irOp = op == "+" ? IROp::Add : op == "-" ? IROp::Sub : op == "*" ? IROp::Mul :
+            op == "/" ? IROp::Div : IROp::Mod;
+            return irAdd(irOp,{left,right},0,8,sign < 0);
+        }
+        default:
+            break;
+    }
+    return irUndefined();
+}
+
+// an array element or struct property as the base and index operands of a load or
+// store, and the displacement. size is its width, which is also the index scale
+std::vector<uint32_t> CodeGen::irAddress(ASTNode* target, uint8_t& size, uint64_t& disp) {
+    disp = 0;
+    if (target->type == NodeType::ArrayAccess) {
+        ArrayAccess* arrAccess = (ArrayAccess*)target;
+        const Variable* var = lookupVariable(((Identifier*)arrAccess->array)->name);
+        uint32_t base = irExpression(arrAccess->array);
+        size = var->getElementSize();
+        uint32_t num;
+        if (isImmediate(arrAccess->index,num) && fitsInt32((uint64_t)num * size)) {
+            disp = (uint64_t)num * size;
+            return {base};
+        }
+        uint32_t index = irExpression(arrAccess->index);
+        if (size == 1 || size == 2 || size == 4 || size == 8) {
+            return {base,index};
+        }
+        index = irAdd(IROp::Mul,{index,irAdd(IROp::Const,{},size)}); // no such scale
+        return {irAdd(IROp::Add,{base,index})};
+    }
+    PropertyAccess* propAccess = (PropertyAccess*)target;
+    const Variable* var = lookupVariable(((Identifier*)propAccess->Struct)->name);
+    const Variable* structVar = lookupField(var,propAccess->property);
+    size = structVar->getSize();
+    disp = structVar->offset;
+    return {irExpression(propAccess->Struct)};
+}
+
+void CodeGen::irCondition(ASTNode* expression, uint32_t trueBlock, uint32_t falseBlock) {
+    uint32_t left, right;
+    Cond cond = Cond::NE;
+    if (expression->type == NodeType::ComparisonExpression) {
+        ComparisonExpression* compExpr = (ComparisonExpression*)expression;
+        int leftSign, rightSign;
+        left = irExpression(compExpr->left,leftSign);
+        right = irExpression(compExpr->right,rightSign);
+        cond = jumpCondition(compExpr->op,combineSigns(leftSign,rightSign) < 0);
+    }
+    else { // any other value is true when not zero
+        left = irExpression(expression);
+        right = irAdd(IROp::Const,{},0);
+    }
+    uint32_t branch = irAdd(IROp::Branch,{left,right});
+    ir.function->values[branch].cond = cond;
+    irAddEdge(ir.block,trueBlock);
+    irAddEdge(ir.block,falseBlock);
+}
+
+void CodeGen::irCodeBlock(CodeBlock* codeBlock) {
+    for (ASTNode* statement : codeBlock->statements) {
+        switch (statement->type) {
+            case NodeType::ReturnStatement: {
+                ReturnStatement* returnStatement = (ReturnStatement*)statement;
+                if (returnStatement->expression != nullptr) {
+                    irAdd(IROp::Return,{irExpression(returnStatement->expression)});
+                }
+                else {
+                    irAdd(IROp::Return);
+                }
+                irEnterBlock(irNewBlock()); // anything after it is unreachable
+                irSeal(ir.block);
+                break;
+            }
+            case NodeType::FunctionCall:
+                irExpression(statement);
+                break;
+            case NodeType::Assignment: {
+                Assignment* assignment = (Assignment*)statement;
+                ASTNode* target = assignment->identifier;
+                if (target->type == NodeType::Identifier) {
+                    const std::string& name = ((Identifier*)target)->name;
+                    const Variable* var = lookupVariable(name);
+                    uint32_t value = irExpression(assignment->expression);
+                    if (var->inRegister) {
+                        if (var->getSize() < 8) {
+                            value = irAdd(IROp::Truncate,{value},0,var->getSize(),var->isSigned());
+                        }
+                        irWriteVariable(name,ir.block,value);
+                    }
+                    else {
+                        irAdd(IROp::Store,{irAdd(IROp::SlotAddr,{},var->offset),value},0,var->getSize());
+                    }
+                }
+                else if (target->type == NodeType::ArrayAccess || target->type == NodeType::PropertyAccess) {
+                    uint8_t size;
+                    uint64_t disp;
+                    std::vector<uint32_t> operands = irAddress(target,size,disp);
+                    operands.insert(operands.begin() + 1,irExpression(assignment->expression));
+                    irAdd(IROp::Store,std::move(operands),disp,size);
+                }
+                break;
+            }
+            case NodeType::IfStatement: {
+                IfStatement* ifStatement = (IfStatement*)statement;
+                uint32_t thenBlock = irNewBlock();
+                uint32_t elseBlock = irNewBlock(); // also keeps the false edge from being critical
+                uint32_t joinBlock = irNewBlock();
+                irCondition(ifStatement->expression,thenBlock,elseBlock);
+                irSeal(thenBlock);
+                irSeal(elseBlock);
+                irEnterBlock(thenBlock);
+                irCodeBlock(ifStatement->codeBlock);
+                irJump(joinBlock);
+                irEnterBlock(elseBlock);
+                if (ifStatement->elseBlock != nullptr) {
+                    irCodeBlock(ifStatement->elseBlock);
+                }
+                irJump(joinBlock);
+                irSeal(joinBlock);
+                irEnterBlock(joinBlock);
+                break;
+            }
+            case NodeType::WhileStatement: {
+                // laid out as: jump header, body, header: branch body/exit
+                WhileStatement* whileStatement = (WhileStatement*)statement;
+                uint32_t bodyBlock = irNewBlock();
+                uint32_t headerBlock = irNewBlock();
+                uint32_t exitBlock = irNewBlock();
+                irJump(headerBlock);
+                ir.block = headerBlock; // entered in layout order after the body
+                irCondition(whileStatement->expression,bodyBlock,exitBlock);
+                irSeal(bodyBlock);
+                irSeal(exitBlock);
+                irEnterBlock(bodyBlock);
+                irCodeBlock(whileStatement->codeBlock);
+                irJump(headerBlock);
+                irSeal(headerBlock);
+                ir.layout.push_back(headerBlock);
+                irEnterBlock(exitBlock);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,508 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "ir.hpp"
+#include "CodeGen.hpp"
+
+// liveness over the blocks, then linear scan over the hull of every value.
+// values live across a call only get callee-saved registers, the rest
+// prefer caller-saved ones, what doesn't fit goes to a frame slot
+void CodeGen::irAllocateRegisters(const IRFunction& function) {
+    const std::vector<IRBlock>& blocks = function.blocks;
+    const std::vector<IRInstr>& values = function.values;
+    size_t blockCount = blocks.size();
+    size_t valueCount = values.size();
+
+    std::vector<std::vector<bool>> liveIn(blockCount,std::vector<bool>(valueCount,false));
+    std::vector<std::vector<bool>> liveOut(blockCount,std::vector<bool>(valueCount,false));
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = blockCount; b > 0; --b) {
+            const IRBlock& block = blocks[b-1];
+            std::vector<bool> live(valueCount,false);
+            for (uint32_t succ : block.succs) {
+                for (size_t v = 0; v < valueCount; ++v) {
+                    if (liveIn[succ][v]) {
+                        live[v] = true;
+                    }
+                }
+                // a phi reads its operand at the end of the matching predecessor
+                size_t predIndex = std::find(blocks[succ].preds.begin(),blocks[succ].preds.end(),b-1) - blocks[succ].preds.begin();
+                for (uint32_t v : blocks[succ].instrs) {
+                    if (values[v].op == IROp::Phi) {
+                        live[values[v].operands[predIndex]] = true;
+                    }
+                }
+            }
+            liveOut[b-1] = live;
+            for (size_t i = block.instrs.size(); i > 0; --i) {
+                uint32_t v = block.instrs[i-1];
+                live[v] = false;
+                if (values[v].op != IROp::Phi) {
+                    for (uint32_t operand : values[v].operands) {
+                        live[operand] = true;
+                    }
+                }
+            }
+            if (live != liveIn[b-1]) {
+                liveIn[b-1] = live;
+                changed = true;
+            }
+        }
+    }
+
+    // uses are at 2k, definitions at 2k+1, so an operand's register can be reused for the result
+    const size_t NONE = SIZE_MAX;
+    std::vector<size_t> starts(valueCount,NONE);
+    std::vector<size_t> ends(valueCount,0);
+    auto extend = [&](uint32_t v, size_t position) {
+        starts[v] = std::min(starts[v],position);
+        ends[v] = std::max(ends[v],position);
+    };
+    std::vector<size_t> blockEnds(blockCount);
+    std::vector<size_t> callPositions;
+    size_t k = 0;
+    for (size_t b = 0; b < blockCount; ++b) {
+        size_t blockStart = 2 * k;
+        blockEnds[b] = 2 * (k + blocks[b].instrs.size() - 1);
+        for (size_t v = 0; v < valueCount; ++v) {
+            if (liveIn[b][v]) {
+                extend(v,blockStart);
+            }
+            if (liveOut[b][v]) {
+                extend(v,blockEnds[b]);
+            }
+        }
+        for (uint32_t v : blocks[b].instrs) {
+            const IRInstr& instr = values[v];
+            if (instr.op == IROp::Phi) {
+                extend(v,blockStart);
+            }
+            else if (instr.op == IROp::Param) {
+                extend(v,1); // all parameters are moved in at once
+            }
+            else {
+                for (uint32_t operand : instr.operands) {
+                    extend(operand,2 * k);
+                }
+                if (IRFunction::hasResult(instr.op)) {
+                    extend(v,2 * k + 1);
+                }
+            }
+            if (instr.op == IROp::Call) {
+                callPositions.push_back(2 * k);
+            }
+            ++k;
+        }
+    }
+    // the phi copies are at the end of the predecessors
+    for (size_t b = 0; b < blockCount; ++b) {
+        for (uint32_t v : blocks[b].instrs) {
+            if (values[v].op == IROp::Phi) {
+                for (uint32_t pred : blocks[b].preds) {
+                    extend(v,blockEnds[pred]);
+                }
+            }
+        }
+    }
+
+    // a constant that is only the right side of branches and add/sub/mul is
+    // folded into their cmp/add/sub/imul as an immediate
+    std::vector<bool> immediateOnly(valueCount,false);
+    for (uint32_t v = 0; v < valueCount; ++v) {
+        immediateOnly[v] = values[v].op == IROp::Const && values[v].imm <= 0x7FFFFFFF;
+    }
+    for (const IRBlock& block : blocks) {
+        for (uint32_t v : block.instrs) {
+            IROp op = values[v].op;
+            bool takesImmediate = op == IROp::Branch || op == IROp::Add || op == IROp::Sub || op == IROp::Mul;
+            for (size_t i = 0; i < values[v].operands.size(); ++i) {
+                if (!takesImmediate || i != 1) {
+                    immediateOnly[values[v].operands[i]] = false;
+                }
+            }
+        }
+    }
+
+    irLocations.assign(valueCount,IRLocation());
+    std::vector<uint32_t> order;
+    for (uint32_t v = 0; v < valueCount; ++v) {
+        if (values[v].op == IROp::SlotAddr) { // folded into the instructions using it
+            irLocations[v].kind = IRLocation::Address;
+            irLocations[v].offset = values[v].imm;
+        }
+        else if (immediateOnly[v]) {
+            irLocations[v].kind = IRLocation::Immediate;
+            irLocations[v].offset = values[v].imm;
+        }
+        else if (starts[v] != NONE && ends[v] > starts[v]) {
+            order.push_back(v);
+        }
+        // a value that is never used is defined into rax
+    }
+    std::sort(order.begin(),order.end(),[&](uint32_t a, uint32_t b) {
+        return starts[a] < starts[b] || (starts[a] == starts[b] && a < b);
+    });
+    std::vector<uint32_t> active;
+    for (uint32_t v : order) {
+        active.erase(std::remove_if(active.begin(),active.end(),[&](uint32_t other) {
+            return ends[other] < starts[v];
+        }),active.end());
+        uint16_t taken = 0;
+        for (uint32_t other : active) {
+            taken |= regBit(irLocations[other].reg);
+        }
+        auto call = std::upper_bound(callPositions.begin(),callPositions.end(),starts[v]);
+        bool acrossCall = (call != callPositions.end() && *call < ends[v]);
+        bool found = false;
+        for (int pass = acrossCall ? 1 : 0; pass < 2 && !found; ++pass) {
+            const Reg* pool = pass == 0 ? irCallerSaved : localRegisters;
+            size_t poolSize = pass == 0 ? 6 : 5;
+            for (size_t i = 0; i < poolSize; ++i) {
+                if (!(taken & regBit(pool[i]))) {
+                    irLocations[v].reg = pool[i];
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            irLocations[v].kind = IRLocation::Stack;
+            irLocations[v].offset = newFrameSlot();
+            continue;
+        }
+        if (isCalleeSaved(irLocations[v].reg)) {
+            usedCalleeSaved |= regBit(irLocations[v].reg);
+        }
+        active.push_back(v);
+    }
+}
+
+// the register holding value, loaded into scratch when it isn't in one
+Reg CodeGen::irUse(std::vector<uint8_t>& code, uint32_t value, Reg scratch) {
+    const IRLocation& location = irLocations[value];
+    if (location.kind == IRLocation::Register) {
+        return location.reg;
+    }
+    irMoveToCode(code,{IRLocation::Register,scratch,0},location);
+    return scratch;
+}
+
+// the memory a load or store accesses, a slot address is folded into an rbp displacement
+MemOperand CodeGen::irMemOperand(std::vector<uint8_t>& code, const IRInstr& instr, size_t indexOperand) {
+    const IRLocation& address = irLocations[instr.operands[0]];
+    MemOperand mem{Reg::RBP,(int32_t)instr.imm};
+    if (address.kind == IRLocation::Address) {
+        mem.disp -= (int32_t)address.offset;
+    }
+    else {
+        mem.base = irUse(code,instr.operands[0],Reg::R11);
+    }
+    if (indexOperand < instr.operands.size()) {
+        mem.index = irUse(code,instr.operands[indexOperand],Reg::RDX);
+        mem.scale = instr.size;
+    }
+    return mem;
+}
+
+// where to compute value, rax when it lives in a frame slot
+Reg CodeGen::irDefReg(uint32_t value) {
+    const IRLocation& location = irLocations[value];
+    return location.kind == IRLocation::Register ? location.reg : Reg::RAX;
+}
+
+void CodeGen::irDefine(std::vector<uint8_t>& code, uint32_t value, Reg reg) {
+    const IRLocation& location = irLocations[value];
+    if (location.kind != IRLocation::Register || location.reg != reg) {
+        irMoveToCode(code,location,{IRLocation::Register,reg,0});
+    }
+}
+
+void CodeGen::irMoveToCode(std::vector<uint8_t>& code, const IRLocation& dst, const IRLocation& src) {
+    if (dst.kind == IRLocation::Register) {
+        if (src.kind == IRLocation::Register) {
+            movRegReg(code,dst.reg,src.reg);
+        }
+        else if (src.kind == IRLocation::Stack) {
+            movRegOffsetRbp(code,dst.reg,src.offset,8);
+        }
+        else {
+            leaRegOffsetRbp(code,dst.reg,src.offset);
+        }
+        return;
+    }
+    Reg reg = src.reg;
+    if (src.kind != IRLocation::Register) { // memory to memory goes through r11
+        reg = Reg::R11;
+        irMoveToCode(code,{IRLocation::Register,reg,0},src);
+    }
+    movOffsetRbpReg(code,dst.offset,reg,8);
+}
+
+// moves that all read before any of them writes, cycles are broken through rax
+void CodeGen::irParallelMove(std::vector<uint8_t>& code, std::vector<IRMove> moves) {
+    moves.erase(std::remove_if(moves.begin(),moves.end(),[](const IRMove& move) {
+        return move.dst == move.src;
+    }),moves.end());
+    while (!moves.empty()) {
+        bool progress = false;
+        for (size_t i = 0; i < moves.size() && !progress; ++i) {
+            bool needed = false;
+            for (size_t j = 0; j < moves.size(); ++j) {
+                if (j != i && moves[j].src == moves[i].dst) {
+                    needed = true;
+                    break;
+                }
+            }
+            if (!needed) {
+                irMoveToCode(code,moves[i].dst,moves[i].src);
+                moves.erase(moves.begin() + i);
+                progress = true;
+            }
+        }
+        if (!progress) {
+            IRLocation parked = moves[0].dst;
+            IRLocation rax = {IRLocation::Register,Reg::RAX,0};
+            irMoveToCode(code,rax,parked);
+            for (IRMove& move : moves) {
+                if (move.src == parked) {
+                    move.src = rax;
+                }
+            }
+        }
+    }
+}
+
+std::vector<uint8_t> CodeGen::generateCodeFromIR(const IRFunction& function) {
+    std::vector<uint8_t> code;
+    size_t relaStart = relaTextEntries.size();
+    size_t stringRelaStart = stringRelaEntries.size();
+    usedCalleeSaved = 0;
+    resetRegisterState(function.frameSize);
+    irAllocateRegisters(function);
+
+    const std::vector<IRBlock>& blocks = function.blocks;
+    std::vector<uint32_t> blockLabels(blocks.size());
+    for (uint32_t& label : blockLabels) {
+        label = newLabel();
+    }
+    for (uint32_t b = 0; b < blocks.size(); ++b) {
+        bindLabel(code,blockLabels[b]);
+        const IRBlock& block = blocks[b];
+        for (size_t i = 0; i < block.instrs.size(); ++i) {
+            uint32_t v = block.instrs[i];
+            const IRInstr& instr = function.values[v];
+            const std::vector<uint32_t>& operands = instr.operands;
+            switch (instr.op) {
+                case IROp::Phi:
+                case IROp::SlotAddr:
+                    break;
+                case IROp::Param: {
+                    if (i > 0 && function.values[block.instrs[i-1]].op == IROp::Param) {
+                        break;
+                    }
+                    std::vector<IRMove> moves;
+                    for (size_t j = i; j < block.instrs.size(); ++j) {
+                        const IRInstr& param = function.values[block.instrs[j]];
+                        if (param.op != IROp::Param) {
+                            break;
+                        }
+                        moves.push_back({irLocations[block.instrs[j]],{IRLocation::Register,positionToRegister[param.imm],0}});
+                    }
+                    irParallelMove(code,moves);
+                    break;
+                }
+                case IROp::Const:
+                    if (irLocations[v].kind == IRLocation::Immediate) {
+                        break;
+                    }
+                    movImm(code,irDefReg(v),instr.imm);
+                    irDefine(code,v,irDefReg(v));
+                    break;
+                case IROp::String:
+                    addConstantStringToRegToCode(code,instr.text,irDefReg(v));
+                    irDefine(code,v,irDefReg(v));
+                    break;
+                case IROp::Add:
+                case IROp::Sub:
+                case IROp::Mul: {
+                    if (irLocations[operands[1]].kind == IRLocation::Immediate) {
+                        Reg left = irUse(code,operands[0],Reg::R11);
+                        Reg dst = irDefReg(v);
+                        uint32_t num = irLocations[operands[1]].offset;
+                        if (instr.op == IROp::Mul) {
+                            imulRegImm(code,dst,left,num);
+                        }
+                        else {
+                            if (dst != left) {
+                                movRegReg(code,dst,left);
+                            }
+                            if (instr.op == IROp::Add) {
+                                addRegImm(code,dst,num);
+                            }
+                            else {
+                                subRegImm(code,dst,num);
+                            }
+                        }
+                        irDefine(code,v,dst);
+                        break;
+                    }
+                    Reg left = irUse(code,operands[0],Reg::R11);
+                    Reg right = irUse(code,operands[1],Reg::RDX);
+                    Reg dst = irDefReg(v);
+                    if (dst == right && dst != left) {
+                        if (instr.op == IROp::Sub) {
+                            movRegReg(code,Reg::RAX,left);
+                            subRegReg(code,Reg::RAX,right);
+                            movRegReg(code,dst,Reg::RAX);
+                            break;
+                        }
+                        right = left; // commutative, dst already holds the right operand
+                    }
+                    else if (dst != left) {
+                        movRegReg(code,dst,left);
+                    }
+                    if (instr.op == IROp::Add) {
+                        addRegReg(code,dst,right);
+                    }
+                    else if (instr.op == IROp::Sub) {
+                        subRegReg(code,dst,right);
+                    }
+                    else {
+                        imulRegReg(code,dst,right);
+                    }
+                    irDefine(code,v,dst);
+                    break;
+                }
+                case IROp::Shl:
+                case IROp::Shr:
+                case IROp::And: {
+                    Reg src = irUse(code,operands[0],Reg::R11);
+                    Reg dst = irDefReg(v);
+                    if (dst != src) {
+                        movRegReg(code,dst,src);
+                    }
+                    if (instr.op == IROp::Shl) {
+                        shlRegImm(code,dst,instr.imm);
+                    }
+                    else if (instr.op == IROp::Shr) {
+                        shrRegImm(code,dst,instr.imm);
+                    }
+                    else {
+                        andRegImm(code,dst,instr.imm);
+                    }
+                    irDefine(code,v,dst);
+                    break;
+                }
+                case IROp::Div:
+                case IROp::Mod: {
+                    Reg left = irUse(code,operands[0],Reg::RAX);
+                    if (left != Reg::RAX) {
+                        movRegReg(code,Reg::RAX,left);
+                    }
+                    Reg right = irUse(code,operands[1],Reg::R11);
+                    if (instr.isSigned) {
+                        cqo(code);
+                        idivReg(code,right);
+                    }
+                    else {
+                        movImm(code,Reg::RDX,0);
+                        divReg(code,right,8);
+                    }
+                    irDefine(code,v,instr.op == IROp::Div ? Reg::RAX : Reg::RDX);
+                    break;
+                }
+                case IROp::Truncate: {
+                    Reg src = irUse(code,operands[0],Reg::R11);
+                    extendRegReg(code,irDefReg(v),src,instr.size,instr.isSigned);
+                    irDefine(code,v,irDefReg(v));
+                    break;
+                }
+                case IROp::Load:
+                    loadRegMem(code,irDefReg(v),irMemOperand(code,instr,1),instr.size,instr.isSigned);
+                    irDefine(code,v,irDefReg(v));
+                    break;
+                case IROp::Store: {
+                    Reg src = irUse(code,operands[1],Reg::RAX);
+                    movPtrRegReg(code,irMemOperand(code,instr,2),src,instr.size);
+                    break;
+                }
+                case IROp::Call: {
+                    std::vector<IRMove> moves;
+                    for (size_t j = 0; j < operands.size(); ++j) {
+                        moves.push_back({{IRLocation::Register,positionToRegister[j],0},irLocations[operands[j]]});
+                    }
+                    irParallelMove(code,moves);
+                    Elf64_Rela rel{};
+                    rel.r_offset = currentFunctionOffset + code.size() + 1;
+                    rel.r_addend = -4;
+                    relaTextEntries.push_back(rel);
+                    relaFuncStrings.push_back(instr.text);
+                    call(code);
+                    irDefine(code,v,Reg::RAX);
+                    break;
+                }
+                case IROp::Jump: {
+                    // copies for the phis of the target, there are no critical edges
+                    uint32_t succ = block.succs[0];
+                    size_t predIndex = std::find(blocks[succ].preds.begin(),blocks[succ].preds.end(),b) - blocks[succ].preds.begin();
+                    std::vector<IRMove> moves;
+                    for (uint32_t phi : blocks[succ].instrs) {
+                        if (function.values[phi].op == IROp::Phi) {
+                            moves.push_back({irLocations[phi],irLocations[function.values[phi].operands[predIndex]]});
+                        }
+                    }
+                    irParallelMove(code,moves);
+                    if (succ != b + 1) {
+                        jmpTo(code,blockLabels[succ]);
+                    }
+                    break;
+                }
+                case IROp::Branch: {
+                    const IRLocation& right = irLocations[operands[1]];
+                    if (right.kind != IRLocation::Immediate) {
+                        Reg left = irUse(code,operands[0],Reg::R11);
+                        cmpRegReg(code,left,irUse(code,operands[1],Reg::RAX));
+                    }
+                    else if (irLocations[operands[0]].kind == IRLocation::Stack) {
+                        cmpOffsetRbpImm(code,irLocations[operands[0]].offset,right.offset,8);
+                    }
+                    else {
+                        Reg left = irUse(code,operands[0],Reg::R11);
+                        if (right.offset == 0) {
+                            testRegReg(code,left,left);
+                        }
+                        else {
+                            cmpRegImm(code,left,right.offset);
+                        }
+                    }
+                    if (block.succs[0] == b + 1) {
+                        jccTo(code,oppositeCond(instr.cond),blockLabels[block.succs[1]]);
+                        break;
+                    }
+                    jccTo(code,instr.cond,blockLabels[block.succs[0]]);
+                    if (block.succs[1] != b + 1) {
+                        jmpTo(code,blockLabels[block.succs[1]]);
+                    }
+                    break;
+                }
+                case IROp::Return: {
+                    if (!operands.empty()) {
+                        Reg src = irUse(code,operands[0],Reg::RAX);
+                        if (src != Reg::RAX) {
+                            movRegReg(code,Reg::RAX,src);
+                        }
+                    }
+                    if (b + 1 < blocks.size()) { // the last block falls through into the epilogue
+                        jmpTo(code,returnLabel);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    addFunctionFrame(code,function.name,relaStart,stringRelaStart);
+    return code;
+}
\ No newline at end of file
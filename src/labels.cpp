@@ -0,0 +1,109 @@
+#include <vector>
+#include <algorithm>
+#include "CodeGen.hpp"
+
+// branches are emitted in their rel32 form and only recorded with their label.
+// once the function body is done, resolveBranches picks the size of every
+// branch and rewrites the code, moving everything that points into it.
+
+uint32_t CodeGen::newLabel() {
+    labelOffsets.push_back(UNBOUND_LABEL);
+    return labelOffsets.size() - 1;
+}
+
+void CodeGen::bindLabel(const std::vector<uint8_t>& code, uint32_t label) {
+    labelOffsets[label] = code.size();
+}
+
+void CodeGen::jmpTo(std::vector<uint8_t>& code, uint32_t label) {
+    branches.push_back({code.size(),label,false,Cond::E,5});
+    jmp(code);
+}
+
+void CodeGen::jccTo(std::vector<uint8_t>& code, Cond cond, uint32_t label) {
+    branches.push_back({code.size(),label,true,cond,6});
+    jcc(code,cond);
+}
+
+void CodeGen::resetLabels() {
+    labelOffsets.clear();
+    branches.clear();
+}
+
+// a branch shrinks from rel32 to rel8 when its target is close enough, and
+// disappears when its target is the next instruction. shrinking a branch only
+// brings the others closer to their targets, so sizes are lowered until none changes
+void CodeGen::resolveBranches(std::vector<uint8_t>& code, size_t relaStart, size_t stringRelaStart) {
+    std::vector<size_t> removedBefore(branches.size() + 1,0); // bytes saved by the branches before each one
+    auto shifted = [&](size_t offset) {
+        size_t before = std::lower_bound(branches.begin(),branches.end(),offset,[](const Branch& branch, size_t value) {
+            return branch.location < value;
+        }) - branches.begin();
+        return offset - removedBefore[before];
+    };
+    auto longSize = [](const Branch& branch) -> uint8_t {
+        return branch.conditional ? 6 : 5;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < branches.size(); ++i) {
+            removedBefore[i + 1] = removedBefore[i] + longSize(branches[i]) - branches[i].size;
+        }
+        for (Branch& branch : branches) {
+            size_t target = labelOffsets[branch.label];
+            int64_t start = shifted(branch.location);
+            uint8_t size = branch.size;
+            if (target > branch.location) { // forward, the bytes between the branch and its target
+                int64_t between = (int64_t)shifted(target) - start - branch.size;
+                size = (between == 0) ? 0 : fitsInt8(between) ? 2 : longSize(branch);
+            }
+            else if (fitsInt8((int64_t)shifted(target) - start - 2)) {
+                size = 2;
+            }
+            if (size < branch.size) {
+                branch.size = size;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<uint8_t> relaxed;
+    relaxed.reserve(code.size());
+    size_t copied = 0;
+    for (const Branch& branch : branches) {
+        relaxed.insert(relaxed.end(),code.begin() + copied,code.begin() + branch.location);
+        copied = branch.location + longSize(branch);
+        int64_t disp = (int64_t)shifted(labelOffsets[branch.label]) - (int64_t)(relaxed.size() + branch.size);
+        if (branch.size == 2) {
+            relaxed.push_back(branch.conditional ? (uint8_t)(0x70 | (uint8_t)branch.cond) : 0xEB);
+            relaxed.push_back((uint8_t)(int8_t)disp);
+        }
+        else if (branch.size > 2) {
+            if (branch.conditional) {
+                jcc(relaxed,branch.cond);
+            }
+            else {
+                jmp(relaxed);
+            }
+            changeJmpOffset(relaxed,relaxed.size() - 4,(uint32_t)disp);
+        }
+    }
+    relaxed.insert(relaxed.end(),code.begin() + copied,code.end());
+
+    // relocations are .text offsets, the function starts at currentFunctionOffset
+    for (size_t i = relaStart; i < relaTextEntries.size(); ++i) {
+        relaTextEntries[i].r_offset = currentFunctionOffset + shifted(relaTextEntries[i].r_offset - currentFunctionOffset);
+    }
+    for (size_t i = stringRelaStart; i < stringRelaEntries.size(); ++i) {
+        stringRelaEntries[i].r_offset = currentFunctionOffset + shifted(stringRelaEntries[i].r_offset - currentFunctionOffset);
+    }
+    for (size_t& offset : labelOffsets) {
+        if (offset != UNBOUND_LABEL) {
+            offset = shifted(offset);
+        }
+    }
+    code.swap(relaxed);
+    branches.clear();
+}
\ No newline at end of file
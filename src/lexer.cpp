@@ -1,182 +1,220 @@
 #include <vector>
-#include <fstream>
-#include <iostream>
-#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cctype>
 #include "token.hpp"
 #include "lexer.hpp"
 
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
-    std::string current;
-    inString = false;
+    tokens.reserve(sourceSize / 4); // rough guess, avoids most regrowth
+    position = 0;
     row = 1;
     column = 0;
-    try {
-        for (size_t i = 0; i < sourceCode.size(); ++i) {
-            ++column;
-            char ch = sourceCode[i];
+    TokenView view;
+    while (next(view)) {
+        uint32_t valueIndex;
+        if (view.type == tokenType::STRING || (view.type == tokenType::CONSTANT && source[view.offset] == '\'')) {
+            valueIndex = strings.intern(tokenValue(view)); // escapes need decoding
+        }
+        else {
+            valueIndex = strings.intern(std::string_view(source + view.offset, view.length));
+        }
+        tokens.push_back(Token(view.type, valueIndex, tokenRow, tokenColumn, view.offset));
+    }
+    return tokens;
+}
 
-            if (ch == '\n' || ch == '\r' || ch == '\t') { 
-                if (ch == '\t') {
-                    column += 4;
-                }
-                else {
-                    ++row;
-                    column = 0;
-                }
-                current.clear();
-                continue;
-            }
+std::vector<TokenView> Lexer::tokenizeViews() {
+    std::vector<TokenView> tokens;
+    tokens.reserve(sourceSize / 4); // rough guess, avoids most regrowth
+    position = 0;
+    row = 1;
+    column = 0;
+    TokenView token;
+    while (next(token)) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
 
-            if (inString) {
-                if (ch == '\"') { // string end
-                    tokens.push_back(createToken(current));
-                    current.clear();
-                    inString = false;
-                    continue;
-                }
-                if (ch == '\\') { // escape char
-                    ++i;
-                    ch = sourceCode[i];
-                    if (escapeChars.find(ch) != escapeChars.end()) {
-                        current += escapeChars[ch];
-                        continue;
-                    }
-                }
-                current += ch;
-                continue;
-            }
+bool Lexer::next(TokenView& token) {
+    while (position < sourceSize) { // whitespace
+        char ch = source[position];
+        if (ch == '\n') {
+            ++row;
+            column = 0;
+        }
+        else if (ch == '\t') {
+            column += 5;
+        }
+        else if (ch == ' ' || ch == '\r' || ch == '\v' || ch == '\f') {
+            ++column;
+        }
+        else {
+            break;
+        }
+        ++position;
+    }
+    if (position >= sourceSize) {
+        return false;
+    }
+    tokenRow = row;
+    tokenColumn = column + 1;
 
-            if (ch == '\"') { // string start
-                inString = true;
-                continue;
-            }
+    size_t start = position;
+    char ch = source[position];
+    size_t length = 0;
+    tokenType type = classifySymbol(ch,peek(position+1),length);
 
-            if (ch == '\'') { // char
-                ++i;
-                ch = sourceCode[i];
-                tokens.push_back(createToken(std::to_string(ch)));
-                ++i;
-                continue;
+    if (type != tokenType::ENDOFFILE) { // symbol
+        token = {(uint32_t)start, (uint32_t)length, type};
+        position += length;
+    }
+    else if (ch == '\"') { // string, the view holds the raw chars between the quotes
+        ++position;
+        while (position < sourceSize && source[position] != '\"') {
+            if (source[position] == '\\') { // escape char
+                ++position;
             }
-
-            if (isSymbol(ch))  {
-                if (!current.empty()) {
-                    tokens.push_back(createToken(current));
-                    current.clear();
-                }
-                if (isKeyword(std::string(1,ch) + sourceCode[i+1])) { // 2 chars symbol
-                    ++i;
-                    tokens.push_back(createToken(std::string(1,ch) + sourceCode[i]));
-                }
-                else {
-                    tokens.push_back(createToken(std::string(1,ch)));
-                }
-                continue;
+            ++position;
+        }
+        token = {(uint32_t)(start+1), (uint32_t)(std::min(position,sourceSize) - start - 1), tokenType::STRING};
+        ++position; // closing quote
+    }
+    else if (ch == '\'') { // char, the view includes the quotes
+        position += (peek(position+1) == '\\') ? 4 : 3;
+        token = {(uint32_t)start, (uint32_t)(std::min(position,sourceSize) - start), tokenType::CONSTANT};
+    }
+    else { // word
+        while (position < sourceSize) {
+            ch = source[position];
+            if (ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f' ||
+                ch == '\"' || ch == '\'' || classifySymbol(ch,peek(position+1),length) != tokenType::ENDOFFILE) {
+                break;
             }
+            ++position;
+        }
+        token = {(uint32_t)start, (uint32_t)(position - start), classifyWord(source + start, position - start)};
+    }
+    position = std::min(position,sourceSize);
+    column += position - start;
+    return true;
+}
 
-            if (ch == ' ') {
-                if (!current.empty()) {
-                    tokens.push_back(createToken(current));
-                }
-                current.clear();
+std::string Lexer::tokenValue(const TokenView& token) const {
+    const char* text = source + token.offset;
+    if (token.type == tokenType::STRING) {
+        std::string value;
+        value.reserve(token.length);
+        for (size_t i = 0; i < token.length; ++i) {
+            if (text[i] == '\\' && i+1 < token.length) {
+                ++i;
+                value += escapeChar(text[i]);
                 continue;
             }
-
-            current += ch;
+            value += text[i];
         }
+        return value;
     }
-    catch (const std::exception& e) {
-        std::cerr << "line: " << row << " column: " << column << 
-        "\nerror while tokenizing: " << current << std::endl; 
-        exit(1);
+    if (token.type == tokenType::CONSTANT && text[0] == '\'') { // 'a' -> "97"
+        char ch = text[1];
+        if (ch == '\\') {
+            ch = escapeChar(text[2]);
+        }
+        return std::to_string(ch);
     }
-    return tokens;
+    return std::string(text,token.length);
 }
 
-Token Lexer::createToken(const std::string& str) {
-    size_t col = column - str.size();
-    if (inString) { 
-        return Token(tokenType::STRING, str, row, col);
-    }
-    else if (isKeyword(str)) {
-        return Token(keywords[str], str, row, col);
+static constexpr bool wordEquals(const char* word, const char* keyword, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (word[i] != keyword[i]) {
+            return false;
+        }
     }
-    else if (std::isdigit(str[0])) { 
-        return Token(tokenType::CONSTANT, str, row, col);
-    } 
-    return Token(tokenType::NAME, str, row, col);
+    return true;
 }
 
-bool Lexer::isSymbol(const char chr) {
-    return symbols.find(chr) != symbols.end();
+tokenType Lexer::classifyWord(const char* word, size_t length) {
+    // keywords are switched on by length first, so a name costs at most 3 compares
+    if (std::isdigit((unsigned char)word[0])) {
+        return tokenType::CONSTANT;
+    }
+    switch (length) {
+        case 2:
+            if (wordEquals(word,"if",2)) return tokenType::IF;
+            break;
+        case 3:
+            if (wordEquals(word,"int",3)) return tokenType::TYPE;
+            break;
+        case 4:
+            if (wordEquals(word,"void",4)) return tokenType::TYPE;
+            if (wordEquals(word,"char",4)) return tokenType::TYPE;
+            if (wordEquals(word,"else",4)) return tokenType::ELSE;
+            break;
+        case 5:
+            if (wordEquals(word,"while",5)) return tokenType::WHILE;
+            if (wordEquals(word,"short",5)) return tokenType::TYPE;
+            break;
+        case 6:
+            if (wordEquals(word,"return",6)) return tokenType::RETURN;
+            if (wordEquals(word,"struct",6)) return tokenType::STRUCT;
+            break;
+        case 7:
+            if (wordEquals(word,"uint8_t",7)) return tokenType::TYPE;
+            break;
+        case 8:
+            if (wordEquals(word,"uint",4) && wordEquals(word+6,"_t",2) &&
+               (wordEquals(word+4,"64",2) || wordEquals(word+4,"32",2) || wordEquals(word+4,"16",2))) {
+                return tokenType::TYPE;
+            }
+            break;
+    }
+    return tokenType::NAME;
 }
 
-bool Lexer::isKeyword(const std::string& token) {
-    return keywords.find(token) != keywords.end();
+tokenType Lexer::classifySymbol(char chr, char nextChr, size_t& length) {
+    // returns ENDOFFILE when chr isn't a symbol
+    length = 1;
+    switch (chr) {
+        case ';': return tokenType::SEMICOLON;
+        case '+': case '-': case '*': case '/': case '%': case '&': return tokenType::OPERATION;
+        case '(': case ')': return tokenType::PARENTHESES;
+        case '{': case '}': return tokenType::CURLY_BRACKET;
+        case '[': case ']': return tokenType::SQUARE_BRACKET;
+        case ',': return tokenType::COMMA;
+        case '.': return tokenType::DOT;
+        case '=':
+            if (nextChr == '=') {
+                length = 2;
+                return tokenType::COMPARISON;
+            }
+            return tokenType::ASSIGNMENT;
+        case '<': case '>':
+            if (nextChr == '=') {
+                length = 2;
+            }
+            return tokenType::COMPARISON;
+        case '!':
+            if (nextChr == '=') {
+                length = 2;
+                return tokenType::COMPARISON;
+            }
+            break;
+    }
+    return tokenType::ENDOFFILE;
 }
 
-std::unordered_map<std::string,tokenType> Lexer::keywords = {
-    {"return",tokenType::RETURN},
-    {"if",tokenType::IF},
-    {"while",tokenType::WHILE},
-    {"struct",tokenType::STRUCT},
-    {";",tokenType::SEMICOLON},
-    {"+",tokenType::OPERATION},
-    {"-",tokenType::OPERATION},
-    {"*",tokenType::OPERATION},
-    {"/",tokenType::OPERATION},
-    {"%",tokenType::OPERATION},
-    {"&",tokenType::OPERATION},
-    {"(",tokenType::PARENTHESES},
-    {")",tokenType::PARENTHESES},
-    {"{",tokenType::CURLY_BRACKET},
-    {"}",tokenType::CURLY_BRACKET},
-    {"[",tokenType::SQUARE_BRACKET},
-    {"]",tokenType::SQUARE_BRACKET},
-    {",",tokenType::COMMA},
-    {".",tokenType::DOT},
-    {"=",tokenType::ASSIGNMENT},
-    {"==",tokenType::COMPARISON},
-    {"!=",tokenType::COMPARISON},
-    {">",tokenType::COMPARISON},
-    {"<",tokenType::COMPARISON},
-    {">=",tokenType::COMPARISON},
-    {"<=",tokenType::COMPARISON},
-    {"int",tokenType::TYPE},
-    {"void",tokenType::TYPE},
-    {"uint64_t",tokenType::TYPE},
-    {"uint32_t",tokenType::TYPE},
-    {"uint16_t",tokenType::TYPE},
-    {"uint8_t",tokenType::TYPE},
-    {"char",tokenType::TYPE}
-};
-
-std::unordered_map<char,bool> Lexer::symbols = {
-    {'+',true},
-    {'-',true},
-    {'*',true},
-    {'/',true},
-    {'%',true},
-    {'(',true},
-    {')',true},
-    {'{',true},
-    {'}',true},
-    {'[',true},
-    {']',true},
-    {',',true},
-    {';',true},
-    {'=',true},
-    {'&',true},
-    {'<',true},
-    {'>',true},
-    {'.',true},
-};
-
-std::unordered_map<char,char> Lexer::escapeChars = {
-    {'n','\n'}, // new line
-    {'r','\r'}, // carriage return
-    {'t','\t'}, // tab
-    {'v','\v'}, // vertical tab
-    {'a','\a'}, // alert
-};
\ No newline at end of file
+char Lexer::escapeChar(char chr) {
+    switch (chr) {
+        case 'n': return '\n'; // new line
+        case 'r': return '\r'; // carriage return
+        case 't': return '\t'; // tab
+        case 'v': return '\v'; // vertical tab
+        case 'a': return '\a'; // alert
+        case '0': return '\0';
+    }
+    return chr; // \\ \" \'
+}
\ No newline at end of file
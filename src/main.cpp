@@ -1,59 +1,393 @@
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+#include <charconv>
+#include <system_error>
+#include <limits>
 #include "preprocessor.hpp"
 #include "token.hpp"
+#include "stringTable.hpp"
 #include "lexer.hpp"
 #include "ASTnode.hpp"
 #include "parser.hpp"
+#include "astArena.hpp"
+#include "flatAST.hpp"
+#include "optimizer.hpp"
 #include "codeGen.hpp"
+#include "threadPool.hpp"
+#include "compileCache.hpp"
+#include "timeReport.hpp"
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: compiler <filename>\n";
-        exit(1);
+struct Options {
+    bool useFlatAST = false;
+    bool optimize = false;
+    bool useIR = false;
+    bool dceReport = false;
+    unsigned jobs = 1;
+    bool dumpIR = false;
+    std::string dumpIRFunction;
+    std::string cacheDirectory; // no cache when empty
+    uint64_t cacheBytes = 256ull << 20;
+    bool cacheStats = false;
+    bool dumpTokens = false;
+    bool dumpAST = false;
+    bool timeReport = false; // per stage times and allocations
+    bool stats = false;      // counters of what was produced
+    bool reportJSON = false;
+};
+
+// the options that change the object file, part of the cache key
+static std::string codeOptions(const Options& options) {
+    std::string key;
+    key += options.useFlatAST ? "flat " : "tree ";
+    key += options.optimize ? "-O " : "";
+    key += options.useIR ? "ir" : "";
+    return key;
+}
+
+static std::string objectFileName(std::string filename) {
+    size_t nameSize = filename.size();
+    if (nameSize >= 2 && filename.substr(nameSize-2,nameSize-1) == ".c") {
+        filename[nameSize-1] = 'o';
     }
+    else {
+        filename += ".o";
+    }
+    return filename;
+}
 
-    std::string filename = argv[1];
+// compiles one file into its .o, the outcome goes to message. a failing file
+// never takes the process down, so a batch keeps going with the other inputs.
+// the token, tree and IR dumps only happen when verbose
+static bool compileFile(const std::string& filename, const Options& options, CompileCache* cache, bool verbose,
+    TimeReport& report, std::string& message) {
     std::ifstream fileStream = std::ifstream(filename);
     if (!fileStream.is_open()) {
-        std::cerr << "Error opening file: " << filename;
-        exit(1);
+        message = "Error opening file: " + filename;
+        return false;
     }
 
-    Preprocessor preprocessor = Preprocessor();
-    std::string PreProcessedCode = preprocessor.preProcess(fileStream);
-    fileStream.close();
+    try {
+        report.start("preprocess");
+        Preprocessor preprocessor = Preprocessor();
+        std::string PreProcessedCode = preprocessor.preProcess(fileStream);
+        fileStream.close();
+        report.count("sourceBytes",PreProcessedCode.size());
+        report.count("lines",std::count(PreProcessedCode.begin(),PreProcessedCode.end(),'\n'));
 
-    Lexer lexer = Lexer(PreProcessedCode);
-    std::vector<Token> tokens = lexer.tokenize();
+        std::string objectFile = objectFileName(filename);
+        std::string cacheKey;
+        if (cache != nullptr) {
+            report.start("cache");
+            cacheKey = CompileCache::key(PreProcessedCode,preprocessor.definedMacros(),codeOptions(options));
+            if (cache->fetch(cacheKey,objectFile)) {
+                report.stop();
+                report.count("cacheHit",1);
+                message = "Object file " + objectFile + " restored from cache";
+                return true;
+            }
+        }
 
-    std::cout << "List of tokens:\n";
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        tokens[i].print();
+        report.start("tokenize");
+        StringTable strings;
+        Lexer lexer = Lexer(PreProcessedCode,strings);
+        std::vector<Token> tokens = lexer.tokenize();
+        report.stop();
+        report.count("tokens",tokens.size());
+
+        if (verbose && options.dumpTokens) {
+            std::cout << "List of tokens:\n";
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                tokens[i].print(strings);
+                std::cout << "\n";
+            }
+            std::cout << "\n";
+        }
+
+        report.start("parse");
+        ASTArena arena;
+        Parser parser = Parser(std::move(tokens),strings,arena);
+        ProgramRoot* treeRoot = parser.parse();
+        report.stop();
+        report.count("astNodes",arena.totalNodes());
+        report.count("astBytes",arena.bytesUsed());
+
+        CodeGen codeGen = CodeGen();
+        codeGen.entryFunctionName = "main";
+        codeGen.promoteLocals = options.optimize;
+        codeGen.useIR = options.useIR;
+        codeGen.dumpIR = options.dumpIR && verbose;
+        codeGen.dumpIRFunction = options.dumpIRFunction;
+        codeGen.jobs = verbose ? options.jobs : 1; // a batch already uses the threads on files
+        if (!codeGen.dumpIR) { // reused functions have no IR to print
+            codeGen.functionCache = cache;
+        }
+
+        if (options.optimize) {
+            report.start("optimize");
+            Optimizer optimizer(arena);
+            optimizer.fold(treeRoot);
+            bool dceReport = options.dceReport && verbose;
+            // the report generates the code once more on each side of the pass, into throwaway generators
+            CodeGen before = codeGen;
+            before.dumpIR = false;
+            before.functionCache = nullptr; // its code is not what the fingerprints stand for
+            if (dceReport) {
+                before.generateText(treeRoot);
+            }
+            optimizer.eliminateDeadCode(treeRoot);
+            if (dceReport) {
+                CodeGen after = codeGen;
+                after.dumpIR = false;
+                after.functionCache = nullptr;
+                after.generateText(treeRoot);
+                std::cout << "Dead code elimination:\n";
+                for (size_t i = 0; i < after.functionSizes.size(); ++i) {
+                    const CodeGen::FunctionSize& old = before.functionSizes[i];
+                    const CodeGen::FunctionSize& now = after.functionSizes[i];
+                    const Optimizer::DeadCodeStats& stats = optimizer.deadCodeStats[i];
+                    std::cout << now.name << ": " << old.codeBytes - now.codeBytes << " bytes of code removed ("
+                    << old.codeBytes << " -> " << now.codeBytes << "), " << old.frameBytes - now.frameBytes
+                    << " bytes of stack frame (" << old.frameBytes << " -> " << now.frameBytes << "), "
+                    << stats.statements << " statements, " << stats.declarations << " locals\n";
+                }
+                std::cout << "\n";
+            }
+            report.stop();
+        }
+        if (verbose && options.dumpAST) {
+            treeRoot->print();
+            arena.printStats(std::cout);
+        }
+
+        std::vector<uint8_t> textData;
+        if (options.useFlatAST) {
+            report.start("flatten");
+            FlatAST flatAST;
+            flatAST.build(treeRoot);
+            arena.release(); // the pointer tree isn't needed anymore
+            report.start("codegen");
+            textData = codeGen.generateText(flatAST);
+        }
+        else {
+            report.start("codegen");
+            textData = codeGen.generateText(treeRoot);
+        }
+        report.start("write");
+        bool success = codeGen.writeObjectFile(textData,objectFile);
+        report.stop();
+        report.count("textBytes",codeGen.objectStats.textBytes);
+        report.count("rodataBytes",codeGen.objectStats.rodataBytes);
+        report.count("relocations",codeGen.objectStats.relocations);
+        report.count("symbols",codeGen.objectStats.symbols);
+        report.count("objectBytes",codeGen.objectStats.fileBytes);
+        if (!success) {
+            message = "Error while making object file " + objectFile;
+            return false;
+        }
+        if (cache != nullptr) {
+            cache->store(cacheKey,objectFile);
+        }
+        message = "Object file " + objectFile + " successfully created";
+        return true;
+    }
+    catch (const ParseError& error) {
+        message = filename + ":" + error.what();
+    }
+    catch (const std::exception& error) {
+        message = filename + ": " + error.what();
+    }
+    report.stop();
+    return false;
+}
+
+// one JSON object per file, in an array for a batch
+static void printReports(const std::vector<TimeReport>& reports, const Options& options) {
+    if (!options.timeReport && !options.stats) {
+        return;
+    }
+    if (!options.reportJSON) {
+        for (const TimeReport& report : reports) {
+            report.print(std::cout,options.timeReport,options.stats);
+        }
+        return;
+    }
+    if (reports.size() == 1) {
+        reports[0].printJSON(std::cout,options.timeReport,options.stats);
         std::cout << "\n";
+        return;
+    }
+    std::cout << "[\n";
+    for (size_t i = 0; i < reports.size(); ++i) {
+        reports[i].printJSON(std::cout,options.timeReport,options.stats);
+        std::cout << (i + 1 < reports.size() ? ",\n" : "\n");
     }
-    std::cout << "\n";
+    std::cout << "]\n";
+}
 
-    Parser parser = Parser(tokens);
-    ProgramRoot* treeRoot = parser.parse();
-    treeRoot->print();
+// the whole of text as a decimal number, false when it isn't one or doesn't fit
+static bool parseNumber(const std::string& text, uint64_t& value) {
+    const char* end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(),end,value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
 
-    size_t nameSize = filename.size();
-    if (filename.substr(nameSize-2,nameSize-1) == ".c") {
-        filename[nameSize-1] = 'o';
+// @file lists more inputs, separated by whitespace
+static bool addInput(const std::string& arg, std::vector<std::string>& filenames) {
+    if (arg.size() < 2 || arg[0] != '@') {
+        filenames.push_back(arg);
+        return true;
     }
-    else {
-        filename += ".o";
+    std::ifstream responseFile(arg.substr(1));
+    if (!responseFile.is_open()) {
+        std::cerr << "Error opening file: " << arg.substr(1) << "\n";
+        return false;
+    }
+    std::string filename;
+    while (responseFile >> filename) {
+        filenames.push_back(filename);
     }
+    return true;
+}
 
-    CodeGen codeGen = CodeGen();
-    codeGen.entryFunctionName = "main";
-    bool success = codeGen.generateObjectFile(treeRoot,filename);
-    if (!success) {
-        std::cout << "Error while making object file " << filename;
+int main(int argc, char* argv[]) {
+    std::vector<std::string> filenames;
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--flat-ast") {
+            options.useFlatAST = true;
+        }
+        else if (arg == "-O") {
+            options.optimize = true;
+        }
+        else if (arg == "--dce-report") { // implies -O
+            options.optimize = true;
+            options.dceReport = true;
+        }
+        else if (arg.rfind("-j",0) == 0) { // -jN or -j N, 0 for one thread per core
+            std::string count = arg.substr(2);
+            if (count.empty() && i + 1 < argc) {
+                count = argv[++i];
+            }
+            uint64_t jobs;
+            if (!parseNumber(count,jobs) || jobs > std::numeric_limits<unsigned>::max()) {
+                std::cerr << "Expected a thread count after -j, got \"" << count << "\"\n";
+                exit(1);
+            }
+            options.jobs = (unsigned)jobs;
+            if (options.jobs == 0) {
+                options.jobs = std::max(std::thread::hardware_concurrency(),1u);
+            }
+        }
+        else if (arg == "--ir") {
+            options.useIR = true;
+        }
+        else if (arg.rfind("--dump-ir",0) == 0) { // --dump-ir or --dump-ir=function
+            options.useIR = true;
+            options.dumpIR = true;
+            if (arg.size() > 10 && arg[9] == '=') {
+                options.dumpIRFunction = arg.substr(10);
+            }
+        }
+        else if (arg.rfind("--cache-dir=",0) == 0) {
+            options.cacheDirectory = arg.substr(12);
+        }
+        else if (arg.rfind("--cache-size=",0) == 0) { // in megabytes
+            uint64_t megabytes;
+            if (!parseNumber(arg.substr(13),megabytes) || megabytes > (std::numeric_limits<uint64_t>::max() >> 20)) {
+                std::cerr << "Expected a size in megabytes after --cache-size=, got \"" << arg.substr(13) << "\"\n";
+                exit(1);
+            }
+            options.cacheBytes = megabytes << 20;
+        }
+        else if (arg == "--cache-stats") {
+            options.cacheStats = true;
+        }
+        else if (arg == "--dump-tokens") {
+            options.dumpTokens = true;
+        }
+        else if (arg == "--dump-ast") {
+            options.dumpAST = true;
+        }
+        else if (arg == "--time-report" || arg == "--time-report=json") {
+            options.timeReport = true;
+            options.reportJSON |= arg.size() > 13;
+        }
+        else if (arg == "--stats" || arg == "--stats=json") {
+            options.stats = true;
+            options.reportJSON |= arg.size() > 7;
+        }
+        else if (!addInput(arg,filenames)) {
+            exit(1);
+        }
+    }
+    if (filenames.empty()) {
+        std::cerr << "Usage: compiler [--flat-ast] [-O] [--dce-report] [--ir] [--dump-ir[=function]] [-j threads]\n"
+        << "                [--cache-dir=directory] [--cache-size=megabytes] [--cache-stats]\n"
+        << "                [--dump-tokens] [--dump-ast] [--time-report[=json]] [--stats[=json]] <filename | @file>...\n";
         exit(1);
     }
-    std::cout << "Object file " << filename << " successfully created\n";
-    exit(0);
+
+    if (options.timeReport) {
+        TimeReport::countAllocations();
+    }
+
+    // stdout only carries the JSON when it is asked for, so it can be parsed as is
+    std::ostream& status = options.reportJSON ? std::cerr : std::cout;
+
+    std::unique_ptr<CompileCache> cache;
+    if (!options.cacheDirectory.empty()) {
+        cache = std::make_unique<CompileCache>(options.cacheDirectory,options.cacheBytes);
+    }
+    auto finish = [&](int exitCode) {
+        if (cache) {
+            cache->evict();
+            cache->saveStats();
+            if (options.cacheStats) {
+                cache->printStats(status);
+            }
+        }
+        exit(exitCode);
+    };
+
+    std::vector<TimeReport> reports(filenames.begin(),filenames.end());
+    if (filenames.size() == 1) {
+        std::string message;
+        bool success = compileFile(filenames[0],options,cache.get(),true,reports[0],message);
+        (success ? status : std::cerr) << message << "\n";
+        printReports(reports,options);
+        finish(success ? 0 : 1);
+    }
+
+    // batch: -j is the number of files compiled at once, results are printed in input order
+    std::vector<std::string> messages(filenames.size());
+    std::vector<char> results(filenames.size());
+    {
+        ThreadPool pool(std::min((size_t)options.jobs,filenames.size()));
+        for (size_t i = 0; i < filenames.size(); ++i) {
+            pool.submit([&,i]() {
+                results[i] = compileFile(filenames[i],options,cache.get(),false,reports[i],messages[i]);
+            });
+        }
+        pool.wait();
+    }
+    size_t failed = 0;
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        if (results[i]) {
+            status << messages[i] << "\n";
+        }
+        else {
+            std::cerr << messages[i] << "\n";
+            ++failed;
+        }
+    }
+    status << filenames.size() - failed << " of " << filenames.size() << " files compiled\n";
+    printReports(reports,options);
+    finish(failed == 0 ? 0 : 1);
 }
\ No newline at end of file
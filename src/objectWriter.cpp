@@ -0,0 +1,69 @@
+#include <fstream>
+#include <algorithm>
+#include "objectWriter.hpp"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#endif
+
+static const uint8_t zeros[16] = {};
+
+void ObjectWriter::add(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    pieces.push_back({data,size});
+    totalSize += size;
+}
+
+void ObjectWriter::padTo(uint64_t offset) {
+    while (totalSize < offset) {
+        add(zeros,std::min((uint64_t)sizeof(zeros),offset - totalSize));
+    }
+}
+
+#ifdef _WIN32
+bool ObjectWriter::write(const std::string& filename) const {
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs) {
+        return false;
+    }
+    for (const Piece& piece : pieces) {
+        ofs.write((const char*)piece.data,piece.size);
+    }
+    return (bool)ofs;
+}
+#else
+bool ObjectWriter::write(const std::string& filename) const {
+    int fd = open(filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<iovec> vectors(pieces.size());
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        vectors[i].iov_base = (void*)pieces[i].data;
+        vectors[i].iov_len = pieces[i].size;
+    }
+    // writev may stop early, and takes at most IOV_MAX pieces at a time
+    size_t first = 0;
+    while (first < vectors.size()) {
+        int count = (int)std::min(vectors.size() - first,(size_t)IOV_MAX);
+        ssize_t written = writev(fd,&vectors[first],count);
+        if (written < 0) {
+            close(fd);
+            return false;
+        }
+        while (first < vectors.size() && (size_t)written >= vectors[first].iov_len) {
+            written -= vectors[first].iov_len;
+            ++first;
+        }
+        if (written > 0) {
+            vectors[first].iov_base = (char*)vectors[first].iov_base + written;
+            vectors[first].iov_len -= written;
+        }
+    }
+    return close(fd) == 0;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,578 @@
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include "ASTnode.hpp"
+#include "optimizer.hpp"
+
+void Optimizer::fold(ProgramRoot* root) {
+    for (ASTNode* element : root->programElements) {
+        if (element->type == NodeType::Struct) {
+            Struct* structNode = (Struct*)element;
+            for (const ASTNode* node : structNode->properties) {
+                const VariableDeclaration* d = (const VariableDeclaration*)node;
+                if (isSignedType(d->varType) && d->pointerCount == 0 && !d->isLocalArray) {
+                    signedFields.insert(structNode->name + "." + d->varName);
+                }
+            }
+        }
+        if (element->type == NodeType::Function) {
+            Function* function = (Function*)element;
+            signedValues.clear();
+            signedElements.clear();
+            structTypes.clear();
+            addSignedNames(function->parameters);
+            addSignedNames(function->codeBlock->statements);
+            foldCodeBlock(function->codeBlock);
+        }
+    }
+}
+
+bool Optimizer::isSignedType(const std::string& type) {
+    return type == "char" || type == "short" || type == "int" || type == "long long";
+}
+
+void Optimizer::addSignedNames(const std::vector<ASTNode*>& declarations) {
+    for (const ASTNode* node : declarations) {
+        if (node->type != NodeType::VariableDeclaration) {
+            continue;
+        }
+        const VariableDeclaration* d = (const VariableDeclaration*)node;
+        if (d->isStruct) {
+            structTypes[d->varName] = d->varType;
+        }
+        else if (isSignedType(d->varType)) {
+            if (d->pointerCount == 0 && !d->isLocalArray) {
+                signedValues.insert(d->varName);
+            }
+            if (d->pointerCount < 2) {
+                signedElements.insert(d->varName);
+            }
+        }
+    }
+}
+
+// true unless every variable the value is read from is unsigned
+bool Optimizer::mayBeSigned(const ASTNode* expression) const {
+    switch (expression->type) {
+        case NodeType::Identifier:
+            return signedValues.count(((const Identifier*)expression)->name) > 0;
+        case NodeType::ArrayAccess: {
+            const ASTNode* array = ((const ArrayAccess*)expression)->array;
+            return array->type != NodeType::Identifier || signedElements.count(((const Identifier*)array)->name) > 0;
+        }
+        case NodeType::PropertyAccess: {
+            const PropertyAccess* propAccess = (const PropertyAccess*)expression;
+            if (propAccess->Struct->type != NodeType::Identifier) {
+                return true;
+            }
+            auto found = structTypes.find(((const Identifier*)propAccess->Struct)->name);
+            return found == structTypes.end() || signedFields.count(found->second + "." + propAccess->property) > 0;
+        }
+        case NodeType::UnaryExpression: {
+            const UnaryExpression* unaryExpr = (const UnaryExpression*)expression;
+            if (unaryExpr->op != "*") {
+                return false;
+            }
+            return unaryExpr->expression->type != NodeType::Identifier ||
+            signedElements.count(((const Identifier*)unaryExpr->expression)->name) > 0;
+        }
+        case NodeType::BinaryExpression: {
+            const BinaryExpression* binExpr = (const BinaryExpression*)expression;
+            return mayBeSigned(binExpr->left) || mayBeSigned(binExpr->right);
+        }
+        default:
+            return false;
+    }
+}
+
+void Optimizer::foldCodeBlock(CodeBlock* codeBlock) {
+    std::vector<ASTNode*> statements;
+    for (ASTNode* statement : codeBlock->statements) {
+        switch (statement->type) {
+            case NodeType::Assignment: {
+                Assignment* assignment = (Assignment*)statement;
+                assignment->identifier = foldExpression(assignment->identifier);
+                assignment->expression = foldExpression(assignment->expression);
+                break;
+            }
+            case NodeType::ReturnStatement: {
+                ReturnStatement* returnStatement = (ReturnStatement*)statement;
+                if (returnStatement->expression != nullptr) {
+                    returnStatement->expression = foldExpression(returnStatement->expression);
+                }
+                break;
+            }
+            case NodeType::FunctionCall:
+                foldExpression(statement);
+                break;
+            case NodeType::IfStatement: {
+                IfStatement* ifStatement = (IfStatement*)statement;
+                ifStatement->expression = foldExpression(ifStatement->expression);
+                foldCodeBlock(ifStatement->codeBlock);
+                if (ifStatement->elseBlock != nullptr) {
+                    foldCodeBlock(ifStatement->elseBlock);
+                }
+                int known = knownCondition(ifStatement->expression);
+                if (known == -1) {
+                    break;
+                }
+                // only the taken branch is left, in place of the if
+                CodeBlock* taken = known ? ifStatement->codeBlock : ifStatement->elseBlock;
+                if (taken != nullptr) {
+                    statements.insert(statements.end(),taken->statements.begin(),taken->statements.end());
+                }
+                continue;
+            }
+            case NodeType::WhileStatement: {
+                WhileStatement* whileStatement = (WhileStatement*)statement;
+                whileStatement->expression = foldExpression(whileStatement->expression);
+                foldCodeBlock(whileStatement->codeBlock);
+                if (knownCondition(whileStatement->expression) == 0) { // never entered
+                    continue;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        statements.push_back(statement);
+    }
+    codeBlock->statements = std::move(statements);
+}
+
+ASTNode* Optimizer::foldExpression(ASTNode* expression) {
+    switch (expression->type) {
+        case NodeType::BinaryExpression:
+            return foldBinary((BinaryExpression*)expression);
+        case NodeType::ComparisonExpression: {
+            ComparisonExpression* compExpr = (ComparisonExpression*)expression;
+            compExpr->left = foldExpression(compExpr->left);
+            compExpr->right = foldExpression(compExpr->right);
+            break;
+        }
+        case NodeType::UnaryExpression: {
+            UnaryExpression* unaryExpr = (UnaryExpression*)expression;
+            if (unaryExpr->op != "&") {
+                unaryExpr->expression = foldExpression(unaryExpr->expression);
+            }
+            break;
+        }
+        case NodeType::ArrayAccess: {
+            ArrayAccess* arrAccess = (ArrayAccess*)expression;
+            arrAccess->index = foldExpression(arrAccess->index);
+            break;
+        }
+        case NodeType::FunctionCall:
+            for (ASTNode*& argument : ((FunctionCall*)expression)->arguments) {
+                argument = foldExpression(argument);
+            }
+            break;
+        default:
+            break;
+    }
+    return expression;
+}
+
+// expressions are left-deep, so chains like x+1+2 fold by looking one level down the left side
+ASTNode* Optimizer::foldBinary(BinaryExpression* binExpr) {
+    binExpr->left = foldExpression(binExpr->left);
+    binExpr->right = foldExpression(binExpr->right);
+    ASTNode* left = binExpr->left;
+    ASTNode* right = binExpr->right;
+    const std::string& op = binExpr->op;
+    uint64_t a, b;
+    bool leftNumber = isNumber(left,a);
+    bool rightNumber = isNumber(right,b);
+
+    if (op == "+" || op == "-") {
+        if (leftNumber && rightNumber) {
+            return makeNumber(op == "+" ? a + b : a - b);
+        }
+        if (op == "+" && leftNumber && a == 0) {
+            return right;
+        }
+        if (op == "-" && sameVariable(left,right)) {
+            return makeNumber(0);
+        }
+        if (!rightNumber) {
+            return binExpr;
+        }
+        uint64_t sum = (op == "+") ? b : 0 - b;
+        uint64_t inner;
+        if (left->type == NodeType::BinaryExpression && isNumber(((BinaryExpression*)left)->right,inner)) {
+            BinaryExpression* leftExpr = (BinaryExpression*)left;
+            if (leftExpr->op == "+" || leftExpr->op == "-") { // (x + c1) - c2 is x + (c1 - c2)
+                sum += (leftExpr->op == "+") ? inner : 0 - inner;
+                left = leftExpr->left;
+            }
+        }
+        if (sum == 0) {
+            return left;
+        }
+        if ((int64_t)sum < 0) {
+            return makeBinary(left,"-",0 - sum);
+        }
+        return makeBinary(left,"+",sum);
+    }
+
+    if (op == "*") {
+        if (leftNumber && rightNumber) {
+            return makeNumber(a * b);
+        }
+        if (leftNumber) { // constant to the right
+            std::swap(left,right);
+            b = a;
+            rightNumber = true;
+        }
+        if (!rightNumber) {
+            return binExpr;
+        }
+        if (b == 0 && !hasSideEffects(left)) {
+            return makeNumber(0);
+        }
+        return multiply(left,b);
+    }
+
+    if (op == "/") {
+        if (!rightNumber || b == 0) { // division by zero is left for run time
+            return binExpr;
+        }
+        if (leftNumber) {
+            return makeNumber(a / b);
+        }
+        uint64_t inner;
+        if (left->type == NodeType::BinaryExpression && isNumber(((BinaryExpression*)left)->right,inner)) {
+            BinaryExpression* leftExpr = (BinaryExpression*)left;
+            if (leftExpr->op == ">>") {
+                inner = 1ULL << inner;
+            }
+            // x / c1 / c2 is x / (c1 * c2) while the product fits
+            if ((leftExpr->op == "/" || leftExpr->op == ">>") && inner != 0 && b <= UINT64_MAX / inner) {
+                left = leftExpr->left;
+                b *= inner;
+            }
+        }
+        if (b == 1) {
+            return left;
+        }
+        int shift = powerOfTwo(b);
+        if (shift > 0 && !mayBeSigned(left)) { // a shift would round negative numbers down
+            return makeBinary(left,">>",shift);
+        }
+        return makeBinary(left,"/",b);
+    }
+
+    if (op == "%") {
+        if (!rightNumber || b == 0) {
+            return binExpr;
+        }
+        if (leftNumber) {
+            return makeNumber(a % b);
+        }
+        if (b == 1 && !hasSideEffects(left)) {
+            return makeNumber(0);
+        }
+        if (powerOfTwo(b) > 0 && !mayBeSigned(left)) {
+            return makeBinary(left,"&",b - 1);
+        }
+    }
+    return binExpr;
+}
+
+// left * factor, merged with a multiplication or shift already on the left
+ASTNode* Optimizer::multiply(ASTNode* left, uint64_t factor) {
+    uint64_t inner;
+    if (left->type == NodeType::BinaryExpression && isNumber(((BinaryExpression*)left)->right,inner)) {
+        BinaryExpression* leftExpr = (BinaryExpression*)left;
+        if (leftExpr->op == "*") {
+            factor *= inner;
+            left = leftExpr->left;
+        }
+        else if (leftExpr->op == "<<") {
+            factor *= 1ULL << inner;
+            left = leftExpr->left;
+        }
+    }
+    if (factor == 1) {
+        return left;
+    }
+    int shift = powerOfTwo(factor);
+    if (shift > 0) {
+        return makeBinary(left,"<<",shift);
+    }
+    return makeBinary(left,"*",factor);
+}
+
+int Optimizer::knownCondition(ASTNode* expression) {
+    uint64_t a, b;
+    if (isNumber(expression,a)) {
+        return a != 0;
+    }
+    if (expression->type != NodeType::ComparisonExpression) {
+        return -1;
+    }
+    ComparisonExpression* compExpr = (ComparisonExpression*)expression;
+    const std::string& op = compExpr->op;
+    if (isNumber(compExpr->left,a) && isNumber(compExpr->right,b)) {
+        if (op == "==") return a == b;
+        if (op == "!=") return a != b;
+        if (op == ">") return a > b;
+        if (op == "<") return a < b;
+        if (op == ">=") return a >= b;
+        if (op == "<=") return a <= b;
+    }
+    else if (sameVariable(compExpr->left,compExpr->right)) {
+        return op == "==" || op == ">=" || op == "<=";
+    }
+    return -1;
+}
+
+void Optimizer::eliminateDeadCode(ProgramRoot* root) {
+    for (ASTNode* element : root->programElements) {
+        if (element->type != NodeType::Function) {
+            continue;
+        }
+        Function* function = (Function*)element;
+        CodeBlock* codeBlock = function->codeBlock;
+        DeadCodeStats stats;
+        stats.function = function->name;
+        stats.statements = removeUnreachable(codeBlock);
+
+        // removing a store can leave the values it stored unused, so repeat until nothing changes
+        Uses uses;
+        size_t removed = 1;
+        while (removed > 0) {
+            uses = Uses();
+            collectUses(codeBlock,uses);
+            std::unordered_set<std::string> locals;
+            for (const std::vector<ASTNode*>* declarations : {&function->parameters,&codeBlock->statements}) {
+                for (const ASTNode* node : *declarations) {
+                    if (node->type != NodeType::VariableDeclaration) {
+                        continue;
+                    }
+                    const VariableDeclaration* d = (const VariableDeclaration*)node;
+                    if (!d->isLocalArray && !(d->isStruct && d->pointerCount == 0) && !uses.addressTaken.count(d->varName)) {
+                        locals.insert(d->varName);
+                    }
+                }
+            }
+            removed = removeDeadStores(codeBlock,locals,uses);
+            stats.statements += removed;
+        }
+
+        std::vector<ASTNode*> statements;
+        for (ASTNode* statement : codeBlock->statements) {
+            if (statement->type == NodeType::VariableDeclaration) {
+                const std::string& name = ((VariableDeclaration*)statement)->varName;
+                if (!uses.reads.count(name) && !uses.writes.count(name)) {
+                    ++stats.declarations;
+                    continue;
+                }
+            }
+            statements.push_back(statement);
+        }
+        codeBlock->statements = std::move(statements);
+        deadCodeStats.push_back(stats);
+    }
+}
+
+// drops what follows a return in every block, declarations stay since they are function wide
+size_t Optimizer::removeUnreachable(CodeBlock* codeBlock) {
+    size_t removed = 0;
+    bool returned = false;
+    std::vector<ASTNode*> statements;
+    for (ASTNode* statement : codeBlock->statements) {
+        if (returned && statement->type != NodeType::VariableDeclaration) {
+            ++removed;
+            continue;
+        }
+        if (statement->type == NodeType::IfStatement) {
+            IfStatement* ifStatement = (IfStatement*)statement;
+            removed += removeUnreachable(ifStatement->codeBlock);
+            if (ifStatement->elseBlock != nullptr) {
+                removed += removeUnreachable(ifStatement->elseBlock);
+            }
+        }
+        else if (statement->type == NodeType::WhileStatement) {
+            removed += removeUnreachable(((WhileStatement*)statement)->codeBlock);
+        }
+        else if (statement->type == NodeType::ReturnStatement) {
+            returned = true;
+        }
+        statements.push_back(statement);
+    }
+    codeBlock->statements = std::move(statements);
+    return removed;
+}
+
+// walks the block backwards keeping the locals that are assigned again before
+// any read, a store to one of those or to a local never read at all is dead.
+// nested blocks start over, their ends may loop back or fall out anywhere
+size_t Optimizer::removeDeadStores(CodeBlock* codeBlock, const std::unordered_set<std::string>& locals, const Uses& uses) {
+    size_t removed = 0;
+    std::unordered_set<std::string> overwritten;
+    std::vector<ASTNode*> statements;
+    for (size_t i = codeBlock->statements.size(); i > 0; --i) {
+        ASTNode* statement = codeBlock->statements[i-1];
+        if (statement->type == NodeType::Assignment && ((Assignment*)statement)->identifier->type == NodeType::Identifier) {
+            Assignment* assignment = (Assignment*)statement;
+            const std::string& name = ((Identifier*)assignment->identifier)->name;
+            if (locals.count(name) && (!uses.reads.count(name) || overwritten.count(name))) {
+                if (!hasSideEffects(assignment->expression)) {
+                    ++removed;
+                    continue;
+                }
+                if (assignment->expression->type == NodeType::FunctionCall) { // the call stays for its side effects
+                    statement = assignment->expression;
+                    ++removed;
+                }
+            }
+        }
+        else if (statement->type == NodeType::IfStatement) {
+            IfStatement* ifStatement = (IfStatement*)statement;
+            removed += removeDeadStores(ifStatement->codeBlock,locals,uses);
+            if (ifStatement->elseBlock != nullptr) {
+                removed += removeDeadStores(ifStatement->elseBlock,locals,uses);
+            }
+        }
+        else if (statement->type == NodeType::WhileStatement) {
+            removed += removeDeadStores(((WhileStatement*)statement)->codeBlock,locals,uses);
+        }
+
+        // the statement writes before the earlier ones, but reads before its own write
+        if (statement->type == NodeType::Assignment && ((Assignment*)statement)->identifier->type == NodeType::Identifier) {
+            overwritten.insert(((Identifier*)((Assignment*)statement)->identifier)->name);
+        }
+        Uses statementUses;
+        collectUses(statement,statementUses);
+        for (const auto& [name, count] : statementUses.reads) {
+            overwritten.erase(name);
+        }
+        statements.push_back(statement);
+    }
+    std::reverse(statements.begin(),statements.end());
+    codeBlock->statements = std::move(statements);
+    return removed;
+}
+
+void Optimizer::collectUses(const ASTNode* node, Uses& uses) {
+    switch (node->type) {
+        case NodeType::Identifier:
+            ++uses.reads[((const Identifier*)node)->name];
+            break;
+        case NodeType::BinaryExpression:
+            collectUses(((const BinaryExpression*)node)->left,uses);
+            collectUses(((const BinaryExpression*)node)->right,uses);
+            break;
+        case NodeType::ComparisonExpression:
+            collectUses(((const ComparisonExpression*)node)->left,uses);
+            collectUses(((const ComparisonExpression*)node)->right,uses);
+            break;
+        case NodeType::UnaryExpression: {
+            const UnaryExpression* unaryExpr = (const UnaryExpression*)node;
+            if (unaryExpr->op == "&" && unaryExpr->expression->type == NodeType::Identifier) {
+                uses.addressTaken.insert(((const Identifier*)unaryExpr->expression)->name);
+            }
+            collectUses(unaryExpr->expression,uses);
+            break;
+        }
+        case NodeType::ArrayAccess:
+            collectUses(((const ArrayAccess*)node)->array,uses);
+            collectUses(((const ArrayAccess*)node)->index,uses);
+            break;
+        case NodeType::PropertyAccess:
+            collectUses(((const PropertyAccess*)node)->Struct,uses);
+            break;
+        case NodeType::FunctionCall:
+            for (const ASTNode* argument : ((const FunctionCall*)node)->arguments) {
+                collectUses(argument,uses);
+            }
+            break;
+        case NodeType::Assignment: {
+            const Assignment* assignment = (const Assignment*)node;
+            if (assignment->identifier->type == NodeType::Identifier) {
+                ++uses.writes[((const Identifier*)assignment->identifier)->name];
+            }
+            else {
+                collectUses(assignment->identifier,uses);
+            }
+            collectUses(assignment->expression,uses);
+            break;
+        }
+        case NodeType::ReturnStatement:
+            if (((const ReturnStatement*)node)->expression != nullptr) {
+                collectUses(((const ReturnStatement*)node)->expression,uses);
+            }
+            break;
+        case NodeType::IfStatement: {
+            const IfStatement* ifStatement = (const IfStatement*)node;
+            collectUses(ifStatement->expression,uses);
+            collectUses(ifStatement->codeBlock,uses);
+            if (ifStatement->elseBlock != nullptr) {
+                collectUses(ifStatement->elseBlock,uses);
+            }
+            break;
+        }
+        case NodeType::WhileStatement:
+            collectUses(((const WhileStatement*)node)->expression,uses);
+            collectUses(((const WhileStatement*)node)->codeBlock,uses);
+            break;
+        case NodeType::CodeBlock:
+            for (const ASTNode* statement : ((const CodeBlock*)node)->statements) {
+                collectUses(statement,uses);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool Optimizer::isNumber(const ASTNode* node, uint64_t& value) {
+    if (node->type != NodeType::Constant || ((const Constant*)node)->constantType == "string") {
+        return false;
+    }
+    value = std::stoull(((const Constant*)node)->value);
+    return true;
+}
+
+bool Optimizer::hasSideEffects(const ASTNode* expression) {
+    switch (expression->type) {
+        case NodeType::FunctionCall:
+            return true;
+        case NodeType::BinaryExpression:
+            return hasSideEffects(((const BinaryExpression*)expression)->left) ||
+            hasSideEffects(((const BinaryExpression*)expression)->right);
+        case NodeType::UnaryExpression:
+            return hasSideEffects(((const UnaryExpression*)expression)->expression);
+        case NodeType::ArrayAccess:
+            return hasSideEffects(((const ArrayAccess*)expression)->index);
+        default:
+            return false;
+    }
+}
+
+bool Optimizer::sameVariable(const ASTNode* left, const ASTNode* right) {
+    return left->type == NodeType::Identifier && right->type == NodeType::Identifier &&
+    ((const Identifier*)left)->name == ((const Identifier*)right)->name;
+}
+
+int Optimizer::powerOfTwo(uint64_t value) {
+    if (value == 0 || (value & (value - 1)) != 0) {
+        return -1;
+    }
+    int shift = 0;
+    while ((value >> shift) != 1) {
+        ++shift;
+    }
+    return shift;
+}
+
+Constant* Optimizer::makeNumber(uint64_t value) {
+    // signed text like the parser's folding, the code generators read it with stoll
+    return arena.make<Constant>(std::to_string((long long)value));
+}
+
+BinaryExpression* Optimizer::makeBinary(ASTNode* left, const std::string& op, uint64_t right) {
+    return arena.make<BinaryExpression>(left,op,makeNumber(right));
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include "ASTnode.hpp"
+#include "CodeGen.hpp"
+#include "timeReport.hpp"
+
+// every function is generated by its own generator, as if it were alone in
+// .text and the string pool. the results are merged in source order, rebasing
+// their offsets and interning their strings again, so the object file is the same for any number of threads.
+// this is also how the code of functions is reused from functionCache
+std::vector<uint8_t> CodeGen::generateTextParallel(ProgramRoot* root) {
+    std::vector<Function*> functions;
+    for (ASTNode* element : root->programElements) {
+        if (element->type == NodeType::Function) {
+            functions.push_back((Function*)element);
+        }
+        else if (element->type == NodeType::Struct) {
+            addStruct((Struct*)element); // all of them before the workers copy the tables
+        }
+    }
+
+    std::vector<CodeGen> workers(functions.size());
+    auto setUp = [&](CodeGen& worker) {
+        worker.entryFunctionName = entryFunctionName;
+        worker.promoteLocals = promoteLocals;
+        worker.useIR = useIR;
+        worker.dumpIR = dumpIR;
+        worker.dumpIRFunction = dumpIRFunction;
+        worker.structOffsets = structOffsets;
+        worker.typeSizes = typeSizes;
+    };
+    std::vector<std::vector<uint8_t>> codes(functions.size());
+    // unchanged functions come back from the cache as the state their worker had left
+    std::vector<std::string> fingerprints(functions.size());
+    std::vector<char> reused(functions.size(),false);
+    for (size_t i = 0; i < functions.size(); ++i) {
+        setUp(workers[i]);
+        if (functionCache == nullptr) {
+            continue;
+        }
+        fingerprints[i] = functionFingerprint(functions[i]);
+        std::string data;
+        if (functionCache->fetchFunction(fingerprints[i],data)) {
+            reused[i] = workers[i].loadFunction(data,codes[i]);
+            if (!reused[i]) { // damaged entry
+                workers[i] = CodeGen();
+                setUp(workers[i]);
+                codes[i].clear();
+            }
+        }
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<std::exception_ptr> errors(functions.size()); // rethrown here, a thread can't throw out
+    auto work = [&]() {
+        for (size_t i = next++; i < functions.size(); i = next++) {
+            if (reused[i]) {
+                continue;
+            }
+            try {
+                codes[i] = workers[i].generateFunction(functions[i]);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+                continue;
+            }
+            if (functionCache != nullptr) {
+                functionCache->storeFunction(fingerprints[i],workers[i].saveFunction(codes[i]));
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    size_t threadCount = std::min((size_t)jobs,functions.size());
+    TimeReport::AllocationCounters* counters = TimeReport::threadAllocationCounters();
+    for (size_t i = 1; i < threadCount; ++i) {
+        threads.emplace_back([&work,counters]() {
+            TimeReport::countAllocationsInto(counters); // part of the stage that started them
+            work();
+        });
+    }
+    work();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) { // the first one in source order
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<uint8_t> textData;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        mergeFunction(textData,workers[i],codes[i]);
+    }
+    return textData;
+}
+
+void CodeGen::mergeFunction(std::vector<uint8_t>& textData, const CodeGen& worker, const std::vector<uint8_t>& code) {
+    for (Elf64_Rela rel : worker.relaTextEntries) {
+        rel.r_offset += currentFunctionOffset;
+        relaTextEntries.push_back(rel);
+    }
+    relaFuncStrings.insert(relaFuncStrings.end(),worker.relaFuncStrings.begin(),worker.relaFuncStrings.end());
+    for (size_t i = 0; i < worker.stringRelaEntries.size(); ++i) {
+        Elf64_Rela rel = worker.stringRelaEntries[i];
+        rel.r_offset += currentFunctionOffset;
+        stringRelaEntries.push_back(rel);
+        // interned again, in the same order as generating everything here would have
+        stringRelaStrings.push_back(internString(worker.poolStrings[worker.stringRelaStrings[i]]));
+    }
+
+    for (size_t i = 0; i < worker.functionSymbols.size(); ++i) {
+        Symbol symbol = worker.functionSymbols[i];
+        symbol.st_value += currentFunctionOffset;
+        functionSymbols.push_back(symbol);
+        functionSymbolNames.push_back(worker.functionSymbolNames[i]);
+        localFunctions[worker.functionSymbolNames[i]] = true;
+    }
+    functionSizes.insert(functionSizes.end(),worker.functionSizes.begin(),worker.functionSizes.end());
+    std::cout << worker.irDump;
+
+    currentFunctionOffset += code.size();
+    addCode(textData,code);
+}
\ No newline at end of file
@@ -1,32 +1,36 @@
 #include <vector>
+#include <algorithm>
 #include "parser.hpp"
+#include "hash.hpp"
 #include "token.hpp"
 #include "ASTnode.hpp"
 
 ProgramRoot* Parser::parse() {
-    ProgramRoot* programRoot = new ProgramRoot();
+    ProgramRoot* programRoot = arena.make<ProgramRoot>();
     while (current().type != tokenType::ENDOFFILE) {
         //includes, structs, functions
         if (current().type == tokenType::STRUCT) {
             ASTNode* structNode = parseStruct();
             programRoot->programElements.push_back(structNode);
         }
-
-        if (current().type == tokenType::TYPE) { // make separate in future
+        else if (current().type == tokenType::TYPE) { // make separate in future
             ASTNode* function = parseFunction();
             programRoot->programElements.push_back(function);
         }
+        else {
+            parserError("Expected a struct or a function");
+        }
 
     }
     return programRoot;
 }
 
 
-Token Parser::current() {
+const Token& Parser::current() const {
     if (index < tokens.size()) {
         return tokens[index];
     }
-    return Token(tokenType::ENDOFFILE,"",0,0);
+    return endOfFile;
 }
 
 void Parser::advance() {
@@ -37,26 +41,24 @@ void Parser::back() {
     --index;
 }
 
-Token Parser::peekNext() {
+const Token& Parser::peekNext() const {
     if (index+1 < tokens.size()) {
         return tokens[index+1];
     }
-    return Token(tokenType::ENDOFFILE,"",0,0);
+    return endOfFile;
 }
 
+const Token Parser::endOfFile = Token(tokenType::ENDOFFILE,0,0,0);
+
 void Parser::require(const tokenType type, const std::string& name) {
     if (current().type != type) {
-        std::cerr << "Row: " << current().row << ", Column: " << current().column << "\n";
-        std::cerr << "Expected a : " << name << "\n";
-        exit(1);
+        parserError("Expected a : " + name);
     }
     advance();
 }
 
 void Parser::parserError(const std::string& error) {
-    std::cerr << current().row << ':' << current().column;
-    std::cerr << ' ' << error << '\n';
-    exit(1);
+    throw ParseError(current().row,current().column,error);
 }
 
 ASTNode* Parser::parseStatement() {
@@ -70,7 +72,7 @@ ASTNode* Parser::parseStatement() {
         statement = parseDeclaration();
     }
     else if (current().type == tokenType::NAME) {
-        if (peekNext().type == tokenType::PARENTHESES && peekNext().value == "(") {
+        if (peekNext().type == tokenType::PARENTHESES && value(peekNext()) == "(") {
             statement = parseFunctionCall();
         }
         else {
@@ -84,19 +86,23 @@ ASTNode* Parser::parseStatement() {
     else if (current().type == tokenType::WHILE){
         statement = parseWhileStatement();
     }
+    else {
+        parserError("Expected a statement");
+    }
 
     return statement;  
 }
 
 ASTNode* Parser::parseFunction() {
-    Function* function = new Function();
-    function->returnType = current().value;
+    size_t firstToken = index;
+    Function* function = arena.make<Function>();
+    function->returnType = value(current());
     require(tokenType::TYPE,"type");
-    function->name = current().value;
+    function->name = value(current());
     require(tokenType::NAME,"name");
     // parameters here
     require(tokenType::PARENTHESES,"(");
-    while (current().type != tokenType::PARENTHESES && current().value != ")") {
+    while (current().type != tokenType::PARENTHESES && value(current()) != ")") {
         VariableDeclaration* d = (VariableDeclaration*)parseDeclaration();
         if (d->isLocalArray) { // decay "char* var[]" to "char** var"
             d->isLocalArray = false;
@@ -107,13 +113,30 @@ ASTNode* Parser::parseFunction() {
     require(tokenType::PARENTHESES,")");
     // parameters here
     function->codeBlock = parseCodeBlock();
+    fingerprintFunction(function,firstToken);
     return function;
 }
 
+// the code of a function only depends on its own tokens and the layouts of
+// the structs it names, which is what lets its machine code be reused
+void Parser::fingerprintFunction(Function* function, size_t firstToken) {
+    Hash128 hash;
+    for (size_t i = firstToken; i < index; ++i) {
+        const std::string& text = value(tokens[i]);
+        hash.add((uint64_t)tokens[i].type);
+        hash.add(text);
+        if (structNames.find(text) != structNames.end()
+            && std::find(function->structsUsed.begin(),function->structsUsed.end(),text) == function->structsUsed.end()) {
+            function->structsUsed.push_back(text);
+        }
+    }
+    function->tokenHash = hash.hex();
+}
+
 CodeBlock* Parser::parseCodeBlock() {
-    CodeBlock* codeBlock = new CodeBlock();
+    CodeBlock* codeBlock = arena.make<CodeBlock>();
     require(tokenType::CURLY_BRACKET,"{");
-    while (current().type != tokenType::CURLY_BRACKET && current().value != "}") {
+    while (current().type != tokenType::CURLY_BRACKET && value(current()) != "}") {
         ASTNode* statement = parseStatement();
         codeBlock->statements.push_back(statement);
     }
@@ -126,7 +149,7 @@ ASTNode* Parser::parseExpression() {
     while (shouldExpressionContinue()){
         if (current().type == tokenType::CONSTANT) { 
             if (expression == nullptr) {
-                expression = new Constant(current().value);
+                expression = arena.make<Constant>(value(current()));
             }
             else if (expression->type == NodeType::BinaryExpression) {
                 BinaryExpression* binExpr = (BinaryExpression*)expression;
@@ -135,12 +158,12 @@ ASTNode* Parser::parseExpression() {
                     Constant* otherNode = (Constant*)binExpr->left;
                     long long otherValue = std::stoll(otherNode->value);
                     const std::string& op = binExpr->op;
-                    long long value = std::stoll(current().value); // assuming only constant numbers
-                    value = calculateOperation(otherValue,value,op);
-                    expression = new Constant(std::to_string(value));
+                    long long thisValue = std::stoll(value(current())); // assuming only constant numbers
+                    thisValue = calculateOperation(otherValue,thisValue,op);
+                    expression = arena.make<Constant>(std::to_string(thisValue));
                 }
                 else {
-                    binExpr->right = new Constant(current().value);
+                    binExpr->right = arena.make<Constant>(value(current()));
                 }
             }
             advance(); // constant
@@ -148,13 +171,13 @@ ASTNode* Parser::parseExpression() {
 
         else if (current().type == tokenType::STRING) {
             if (expression == nullptr) {
-                expression = new Constant(current().value);
+                expression = arena.make<Constant>(value(current()));
                 ((Constant*)expression)->constantType = "string";
                 
             }
             else if (expression->type == NodeType::BinaryExpression) {
                 BinaryExpression* binExpr = (BinaryExpression*)expression;
-                binExpr->right = new Constant(current().value);
+                binExpr->right = arena.make<Constant>(value(current()));
                 ((Constant*)binExpr->right)->constantType = "string";
             }
             advance(); // string
@@ -162,12 +185,12 @@ ASTNode* Parser::parseExpression() {
 
         else if (current().type == tokenType::OPERATION) {
             if (expression == nullptr) {
-                expression = new UnaryExpression(current().value);
+                expression = arena.make<UnaryExpression>(value(current()));
             }
             else {
-                BinaryExpression* binExpr = new BinaryExpression();
+                BinaryExpression* binExpr = arena.make<BinaryExpression>();
                 binExpr->left = expression;
-                binExpr->op = current().value;
+                binExpr->op = value(current());
                 expression = binExpr;
             }
             advance(); // operation
@@ -175,7 +198,7 @@ ASTNode* Parser::parseExpression() {
 
 
         else if (current().type == tokenType::NAME) {
-            if (peekNext().type == tokenType::PARENTHESES && peekNext().value == "(") { // functionCall
+            if (peekNext().type == tokenType::PARENTHESES && value(peekNext()) == "(") { // functionCall
                 if (expression == nullptr) {
                     expression = parseFunctionCall();
                 }
@@ -201,6 +224,9 @@ ASTNode* Parser::parseExpression() {
             }
         }
 
+        else { // nothing would consume it, the loop would never end
+            parserError("Unexpected token in expression");
+        }
     }
     return expression;
 }
@@ -208,25 +234,30 @@ ASTNode* Parser::parseExpression() {
 bool Parser::shouldExpressionContinue() {
     return current().type != tokenType::SEMICOLON
     && current().type != tokenType::COMMA 
-    && !(current().type == tokenType::PARENTHESES && current().value == ")")
+    && !(current().type == tokenType::PARENTHESES && value(current()) == ")")
     && current().type != tokenType::COMPARISON
-    && !(current().type == tokenType::SQUARE_BRACKET && current().value == "]");
+    && !(current().type == tokenType::SQUARE_BRACKET && value(current()) == "]")
+    && current().type != tokenType::CURLY_BRACKET // a missing ; ends up here
+    && current().type != tokenType::ENDOFFILE;
 }
 
 ReturnStatement* Parser::parseReturnStatement() {
     advance(); // return
-    ReturnStatement* returnStmt = new ReturnStatement();
+    ReturnStatement* returnStmt = arena.make<ReturnStatement>();
     returnStmt->expression = parseExpression();
     return returnStmt;
 }
 
 ASTNode* Parser::parseFunctionCall() {
-    FunctionCall* funcCall = new FunctionCall();
-    funcCall->name = current().value;
+    FunctionCall* funcCall = arena.make<FunctionCall>();
+    funcCall->name = value(current());
     require(tokenType::NAME,"name");
     require(tokenType::PARENTHESES,"(");
-    while (current().type != tokenType::PARENTHESES && current().value != ")") {
+    while (current().type != tokenType::PARENTHESES && value(current()) != ")") {
         ASTNode* expression = parseExpression();
+        if (expression == nullptr) {
+            parserError("Expected an argument");
+        }
         funcCall->arguments.push_back(expression);
         if (current().type == tokenType::COMMA) {
             advance(); // ,
@@ -247,7 +278,7 @@ ASTNode* Parser::parseDeclaration() {
         advance(); // struct
         isStruct = true;
     }
-    std::string type = current().value;
+    std::string type = value(current());
     if (structNames.find(type) == structNames.end()) { // if not a struct, require type
         require(tokenType::TYPE,"type");
     }
@@ -257,23 +288,23 @@ ASTNode* Parser::parseDeclaration() {
     size_t pointerCount = 0;
     bool isLocalArray = false;
     size_t localArrSize = 0;
-    while (current().type == tokenType::OPERATION && current().value == "*") {
+    while (current().type == tokenType::OPERATION && value(current()) == "*") {
         ++pointerCount;
         advance(); // *
     }
-    std::string name = current().value;
+    std::string name = value(current());
     if (peekNext().type == tokenType::SEMICOLON || peekNext().type == tokenType::COMMA // int a; int a,
-    || peekNext().type == tokenType::PARENTHESES && peekNext().value == ")") { // int a)
+    || peekNext().type == tokenType::PARENTHESES && value(peekNext()) == ")") { // int a)
         advance(); // varName
-        if (!(current().type == tokenType::PARENTHESES && current().value == ")")) {
+        if (!(current().type == tokenType::PARENTHESES && value(current()) == ")")) {
             advance(); // ; or , 
         }
     }
-    else if (peekNext().type == tokenType::SQUARE_BRACKET && peekNext().value == "[") {
+    else if (peekNext().type == tokenType::SQUARE_BRACKET && value(peekNext()) == "[") {
         advance(); // varName
         advance(); // [
         isLocalArray = true;
-        if (current().type == tokenType::SQUARE_BRACKET && current().value == "]" ) { // in function parameter
+        if (current().type == tokenType::SQUARE_BRACKET && value(current()) == "]" ) { // in function parameter
             // int a[],
             advance(); // ]
             if (current().type == tokenType::COMMA)  {
@@ -299,20 +330,20 @@ ASTNode* Parser::parseDeclaration() {
     }
     // if the next token is not a semicolon, stop at the variable name,
     // so the next parseStatement() would begin at "x = 1";
-    return new VariableDeclaration(type,name,pointerCount,isLocalArray,localArrSize,isStruct);
+    return arena.make<VariableDeclaration>(type,name,pointerCount,isLocalArray,localArrSize,isStruct);
 }
 
 ASTNode* Parser::parseAssignment() {
     ASTNode* identifier = parseIdentifier();
     require(tokenType::ASSIGNMENT,"=");
     ASTNode* expression = parseExpression();
-    return new Assignment(identifier,expression);
+    return arena.make<Assignment>(identifier,expression);
 }
 
 ASTNode* Parser::parseIfStatement() {
     advance(); // if 
     require(tokenType::PARENTHESES,"(");
-    IfStatement* ifStatement = new IfStatement();
+    IfStatement* ifStatement = arena.make<IfStatement>();
     ifStatement->expression = parseComparison();
     require(tokenType::PARENTHESES,")");
     ifStatement->codeBlock = parseCodeBlock();
@@ -326,7 +357,7 @@ ASTNode* Parser::parseIfStatement() {
 ASTNode* Parser::parseWhileStatement() {
     advance(); // while
     require(tokenType::PARENTHESES,"(");
-    WhileStatement* whileStatement = new WhileStatement();
+    WhileStatement* whileStatement = arena.make<WhileStatement>();
     whileStatement->expression = parseComparison();
     require(tokenType::PARENTHESES,")");
     whileStatement->codeBlock = parseCodeBlock();
@@ -335,9 +366,9 @@ ASTNode* Parser::parseWhileStatement() {
 
 ASTNode* Parser::parseComparison() {
     // currently supports only 2 expressions
-    ComparisonExpression* expr = new ComparisonExpression();
+    ComparisonExpression* expr = arena.make<ComparisonExpression>();
     expr->left = parseExpression();
-    expr->op = current().value; // > < == >= <=
+    expr->op = value(current()); // > < == >= <=
     require(tokenType::COMPARISON," comparison operator");
     expr->right = parseExpression();
     // || && checks here in the future
@@ -347,37 +378,37 @@ ASTNode* Parser::parseComparison() {
 ASTNode* Parser::parseIdentifier() {
     // name
     // name[expr]
-    std::string name = current().value;
-    Identifier* identifier = new Identifier(name);
+    std::string name = value(current());
+    Identifier* identifier = arena.make<Identifier>(name);
     advance(); // name
-    if (current().type == tokenType::SQUARE_BRACKET && current().value == "[") {
+    if (current().type == tokenType::SQUARE_BRACKET && value(current()) == "[") {
         require(tokenType::SQUARE_BRACKET,"[");
         ASTNode* expression = parseExpression();
         require(tokenType::SQUARE_BRACKET,"]");
-        return new ArrayAccess(identifier,expression);
+        return arena.make<ArrayAccess>(identifier,expression);
     }
     if (current().type == tokenType::DOT) {
         require(tokenType::DOT,".");
-        std::string propertyName = current().value;
+        std::string propertyName = value(current());
         advance(); // property name
-        return new PropertyAccess(identifier,propertyName);
+        return arena.make<PropertyAccess>(identifier,propertyName);
     }
     return identifier;
 }
 
 ASTNode* Parser::parseStruct() {
     advance(); // struct
-    std::string name = current().value;
+    std::string name = value(current());
     structNames[name] = true;
     advance(); // name
     require(tokenType::CURLY_BRACKET,"{");
     std::vector<ASTNode*> properties;
-    while (current().type != CURLY_BRACKET && current().value != "}") {
+    while (current().type != CURLY_BRACKET && value(current()) != "}") {
         properties.push_back(parseDeclaration());
     }
     require(tokenType::CURLY_BRACKET,"}");
     require(tokenType::SEMICOLON,";");
-    return new Struct(name,properties);
+    return arena.make<Struct>(name,properties);
 }
 
 long long Parser::calculateOperation(const long long& value1, const long long& value2, const std::string& operation) {
@@ -390,6 +421,9 @@ long long Parser::calculateOperation(const long long& value1, const long long& v
     if (operation == "*") 
         return value1 * value2;
     
+    if ((operation == "/" || operation == "%") && value2 == 0)
+        parserError("Division by zero in a constant expression");
+
     if (operation == "/") 
         return value1 / value2;
 
@@ -0,0 +1,353 @@
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "ASTnode.hpp"
+#include "CodeGen.hpp"
+
+// register allocation for expression evaluation.
+// subtrees are numbered Sethi-Ullman style and the one needing more registers
+// is evaluated first, its result held in a temp while the other side runs.
+// temps holding a value across a call are taken from the callee-saved registers,
+// which the function saves in its frame when it uses them.
+// with promoteLocals, scalar locals get callee-saved registers of their own
+// by linear scan over their live intervals
+
+// numbered once per node, asking at every level of a chain would be quadratic
+uint32_t CodeGen::registerNeed(const ASTNode* expression) {
+    if (expression->registerNeed == 0) {
+        expression->registerNeed = numberRegisterNeed(expression);
+    }
+    return expression->registerNeed;
+}
+
+uint32_t CodeGen::numberRegisterNeed(const ASTNode* expression) {
+    switch (expression->type) {
+        case NodeType::FunctionCall:
+            return CALL_NEED;
+        case NodeType::BinaryExpression: {
+            const BinaryExpression* binExpr = (const BinaryExpression*)expression;
+            uint32_t left = registerNeed(binExpr->left);
+            if (binExpr->op == "<<" || binExpr->op == ">>" || binExpr->op == "&") { // immediate right side
+                return left;
+            }
+            uint32_t right = registerNeed(binExpr->right);
+            return left == right ? left + 1 : std::max(left,right);
+        }
+        case NodeType::ComparisonExpression: {
+            const ComparisonExpression* compExpr = (const ComparisonExpression*)expression;
+            uint32_t left = registerNeed(compExpr->left);
+            uint32_t right = registerNeed(compExpr->right);
+            return left == right ? left + 1 : std::max(left,right);
+        }
+        case NodeType::UnaryExpression:
+            return registerNeed(((const UnaryExpression*)expression)->expression);
+        case NodeType::ArrayAccess: // index, then the base in a temp
+            return std::max(registerNeed(((const ArrayAccess*)expression)->index),(uint32_t)2);
+        case NodeType::PropertyAccess:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+Reg CodeGen::allocateTemp(std::vector<uint8_t>& code, bool acrossCall, Reg avoid) {
+    // first pass keeps values held across calls in callee-saved registers,
+    // the second takes anything free, caller-saved temps are saved around calls
+    for (int pass = 0; pass < 2; ++pass) {
+        for (Reg reg : tempRegisters) {
+            if (pass == 0 && acrossCall != isCalleeSaved(reg)) {
+                continue;
+            }
+            if (!((liveTemps | localRegs) & regBit(reg))) {
+                liveTemps |= regBit(reg);
+                if (isCalleeSaved(reg)) {
+                    usedCalleeSaved |= regBit(reg);
+                }
+                return reg;
+            }
+        }
+    }
+    // every temp is live, borrow one and keep its value in the frame meanwhile
+    Reg reg = Reg::R10;
+    for (Reg temp : tempRegisters) {
+        if (!(localRegs & regBit(temp)) && temp != avoid) {
+            reg = temp;
+        }
+    }
+    if (spillDepth == spillSlots.size()) {
+        spillSlots.push_back(newFrameSlot());
+    }
+    movOffsetRbpReg(code,spillSlots[spillDepth++],reg,8);
+    ++spilledTemps[(uint8_t)reg];
+    return reg;
+}
+
+void CodeGen::releaseTemp(std::vector<uint8_t>& code, Reg reg) {
+    if (spilledTemps[(uint8_t)reg] > 0) {
+        --spilledTemps[(uint8_t)reg];
+        movRegOffsetRbp(code,reg,spillSlots[--spillDepth],8);
+        return;
+    }
+    liveTemps &= ~regBit(reg);
+}
+
+// nothing to preserve across calls in temp until the expression is done
+int CodeGen::parseExpressionToTemp(std::vector<uint8_t>& code, ASTNode* expression, Reg temp) {
+    uint16_t wasPending = pendingTemps;
+    pendingTemps |= regBit(temp);
+    int sign = parseExpressionToReg(code,expression,temp);
+    pendingTemps = wasPending;
+    return sign;
+}
+
+// one operand ends up in dst and the other in a temp the caller releases.
+// rightInTemp forces the right operand into the temp (divisors).
+// returns the combined sign of the operands
+int CodeGen::parseOperandsToRegs(std::vector<uint8_t>& code, ASTNode* left, ASTNode* right, Reg dst,
+bool rightInTemp, Reg& leftReg, Reg& rightReg) {
+    uint32_t leftNeed = registerNeed(left);
+    uint32_t rightNeed = registerNeed(right);
+    // ties keep right to left order, two leaves have no order to keep
+    bool rightFirst = rightNeed > leftNeed || (rightNeed == leftNeed && leftNeed > 1);
+    // a leaf clobbers nothing, so the first operand can already sit in dst
+    bool firstInDst = (rightFirst ? leftNeed : rightNeed) == 1;
+    if (rightInTemp && rightFirst == firstInDst) {
+        rightFirst = true;
+        firstInDst = false;
+    }
+    ASTNode* first = rightFirst ? right : left;
+    ASTNode* second = rightFirst ? left : right;
+
+    Reg temp;
+    int sign;
+    if (firstInDst) {
+        sign = parseExpressionToReg(code,first,dst);
+        temp = allocateTemp(code,false,dst);
+        sign = combineSigns(sign,parseExpressionToReg(code,second,temp));
+    }
+    else {
+        temp = allocateTemp(code,(rightFirst ? leftNeed : rightNeed) >= CALL_NEED,dst);
+        sign = parseExpressionToTemp(code,first,temp);
+        sign = combineSigns(sign,parseExpressionToReg(code,second,dst));
+    }
+    bool leftInDst = (rightFirst != firstInDst);
+    leftReg = leftInDst ? dst : temp;
+    rightReg = leftInDst ? temp : dst;
+    return sign;
+}
+
+size_t CodeGen::newFrameSlot() {
+    ++frameSlots;
+    return frameVarSizes + 8 * frameSlots;
+}
+
+size_t CodeGen::registerSlot(Reg reg) {
+    if (registerSlots[(uint8_t)reg] == 0) {
+        registerSlots[(uint8_t)reg] = newFrameSlot();
+    }
+    return registerSlots[(uint8_t)reg];
+}
+
+void CodeGen::resetRegisterState(size_t varSizes) {
+    frameVarSizes = varSizes;
+    frameSlots = 0;
+    std::fill(std::begin(registerSlots),std::end(registerSlots),0);
+    spillSlots.clear();
+    spillDepth = 0;
+    liveTemps = 0;
+    pendingTemps = 0;
+    resetLabels();
+    returnLabel = newLabel();
+}
+
+// live temps in r10/r11 don't survive a call
+void CodeGen::saveCallerSavedTemps(std::vector<uint8_t>& code, bool restore) {
+    for (Reg reg : tempRegisters) {
+        if (!isCalleeSaved(reg) && (liveTemps & ~pendingTemps & regBit(reg))) {
+            if (restore) {
+                movRegOffsetRbp(code,reg,registerSlot(reg),8);
+            }
+            else {
+                movOffsetRbpReg(code,registerSlot(reg),reg,8);
+            }
+        }
+    }
+}
+
+void CodeGen::addPrologue(std::vector<uint8_t>& code) {
+    for (Reg reg : tempRegisters) {
+        if (usedCalleeSaved & regBit(reg)) {
+            registerSlot(reg);
+        }
+    }
+    size_t frameSize = frameVarSizes + 8 * frameSlots;
+    size_t pad = (16 - (frameSize % 16)) % 16; // pad to 16
+    startFunction(code);
+    if (frameSize > 0) {
+        subRsp(code,frameSize + pad);
+    }
+    for (Reg reg : tempRegisters) {
+        if (usedCalleeSaved & regBit(reg)) {
+            movOffsetRbpReg(code,registerSlot(reg),reg,8);
+        }
+    }
+}
+
+void CodeGen::addEpilogue(std::vector<uint8_t>& code) {
+    for (Reg reg : tempRegisters) {
+        if (usedCalleeSaved & regBit(reg)) {
+            movRegOffsetRbp(code,reg,registerSlot(reg),8);
+        }
+    }
+    leaveFunction(code);
+}
+
+// positions follow the statements in order. a loop's back edge carries values
+// around, so every interval overlapping a loop is widened to cover all of it
+void CodeGen::collectLiveIntervals(ASTNode* node, size_t& position,
+std::unordered_map<std::string,LiveInterval>& intervals, std::unordered_set<std::string>& addressTaken) {
+    if (node == nullptr) {
+        return;
+    }
+    switch (node->type) {
+        case NodeType::Identifier: {
+            const std::string& name = ((Identifier*)node)->name;
+            auto found = intervals.find(name);
+            if (found == intervals.end()) {
+                intervals[name] = {position,position};
+            }
+            else {
+                found->second.end = position;
+            }
+            ++position;
+            break;
+        }
+        case NodeType::BinaryExpression:
+            collectLiveIntervals(((BinaryExpression*)node)->left,position,intervals,addressTaken);
+            collectLiveIntervals(((BinaryExpression*)node)->right,position,intervals,addressTaken);
+            break;
+        case NodeType::ComparisonExpression:
+            collectLiveIntervals(((ComparisonExpression*)node)->left,position,intervals,addressTaken);
+            collectLiveIntervals(((ComparisonExpression*)node)->right,position,intervals,addressTaken);
+            break;
+        case NodeType::UnaryExpression: {
+            UnaryExpression* unaryExpr = (UnaryExpression*)node;
+            if (unaryExpr->op == "&" && unaryExpr->expression->type == NodeType::Identifier) {
+                addressTaken.insert(((Identifier*)unaryExpr->expression)->name);
+            }
+            collectLiveIntervals(unaryExpr->expression,position,intervals,addressTaken);
+            break;
+        }
+        case NodeType::ArrayAccess:
+            collectLiveIntervals(((ArrayAccess*)node)->array,position,intervals,addressTaken);
+            collectLiveIntervals(((ArrayAccess*)node)->index,position,intervals,addressTaken);
+            break;
+        case NodeType::PropertyAccess:
+            collectLiveIntervals(((PropertyAccess*)node)->Struct,position,intervals,addressTaken);
+            break;
+        case NodeType::FunctionCall:
+            for (ASTNode* arg : ((FunctionCall*)node)->arguments) {
+                collectLiveIntervals(arg,position,intervals,addressTaken);
+            }
+            break;
+        case NodeType::Assignment: // the value is read before the target is written
+            collectLiveIntervals(((Assignment*)node)->expression,position,intervals,addressTaken);
+            collectLiveIntervals(((Assignment*)node)->identifier,position,intervals,addressTaken);
+            break;
+        case NodeType::ReturnStatement:
+            collectLiveIntervals(((ReturnStatement*)node)->expression,position,intervals,addressTaken);
+            break;
+        case NodeType::IfStatement:
+            collectLiveIntervals(((IfStatement*)node)->expression,position,intervals,addressTaken);
+            collectLiveIntervals(((IfStatement*)node)->codeBlock,position,intervals,addressTaken);
+            collectLiveIntervals(((IfStatement*)node)->elseBlock,position,intervals,addressTaken);
+            break;
+        case NodeType::WhileStatement: {
+            size_t loopStart = position;
+            collectLiveIntervals(((WhileStatement*)node)->expression,position,intervals,addressTaken);
+            collectLiveIntervals(((WhileStatement*)node)->codeBlock,position,intervals,addressTaken);
+            size_t loopEnd = position++;
+            for (auto& [name, interval] : intervals) {
+                if (interval.end >= loopStart) {
+                    interval.start = std::min(interval.start,loopStart);
+                    interval.end = loopEnd;
+                }
+            }
+            break;
+        }
+        case NodeType::CodeBlock:
+            for (ASTNode* statement : ((CodeBlock*)node)->statements) {
+                collectLiveIntervals(statement,position,intervals,addressTaken);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void CodeGen::allocateLocalRegisters(Function* function) {
+    std::unordered_map<std::string,LiveInterval> intervals;
+    std::unordered_set<std::string> addressTaken;
+    size_t position = 1; // parameters are defined at 0
+    for (ASTNode* param : function->parameters) {
+        intervals[((VariableDeclaration*)param)->varName] = {0,0};
+    }
+    collectLiveIntervals(function->codeBlock,position,intervals,addressTaken);
+
+    // only scalars declared at the top of the function qualify
+    std::vector<std::pair<std::string,LiveInterval>> candidates;
+    auto addCandidates = [&](const std::vector<ASTNode*>& declarations) {
+        for (ASTNode* node : declarations) {
+            if (node->type != NodeType::VariableDeclaration) {
+                continue;
+            }
+            VariableDeclaration* d = (VariableDeclaration*)node;
+            if (d->isLocalArray || (d->isStruct && d->pointerCount == 0) || addressTaken.count(d->varName)) {
+                continue;
+            }
+            auto found = intervals.find(d->varName);
+            if (found != intervals.end()) {
+                candidates.push_back(*found);
+            }
+        }
+    };
+    addCandidates(function->parameters);
+    addCandidates(function->codeBlock->statements);
+    std::sort(candidates.begin(),candidates.end(),[](const auto& a, const auto& b) {
+        return a.second.start < b.second.start;
+    });
+
+    // linear scan, when registers run out the interval ending last stays on the stack
+    std::vector<std::pair<std::string,LiveInterval>> active;
+    std::vector<Reg> freeRegs(std::rbegin(localRegisters),std::rend(localRegisters));
+    for (const auto& candidate : candidates) {
+        for (size_t i = 0; i < active.size();) {
+            if (active[i].second.end < candidate.second.start) {
+                freeRegs.push_back(promotedLocals[active[i].first]);
+                active.erase(active.begin() + i);
+            }
+            else {
+                ++i;
+            }
+        }
+        if (!freeRegs.empty()) {
+            promotedLocals[candidate.first] = freeRegs.back();
+            freeRegs.pop_back();
+            active.push_back(candidate);
+            continue;
+        }
+        auto last = std::max_element(active.begin(),active.end(),[](const auto& a, const auto& b) {
+            return a.second.end < b.second.end;
+        });
+        if (last->second.end > candidate.second.end) {
+            promotedLocals[candidate.first] = promotedLocals[last->first];
+            promotedLocals.erase(last->first);
+            *last = candidate;
+        }
+    }
+    for (const auto& [name, reg] : promotedLocals) {
+        localRegs |= regBit(reg);
+    }
+    usedCalleeSaved |= localRegs;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#include "stringTable.hpp"
+
+uint32_t StringTable::intern(std::string_view str) {
+    auto it = indices.find(str);
+    if (it != indices.end()) {
+        return it->second;
+    }
+    uint32_t index = strings.size();
+    strings.emplace_back(str);
+    indices[strings.back()] = index;
+    return index;
+}
\ No newline at end of file
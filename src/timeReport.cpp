@@ -0,0 +1,195 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <malloc.h>
+#include "timeReport.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// allocations are only counted once a report asks for them, until then the
+// replaced operators cost an atomic load. the size of a freed block comes from
+// the allocator, so blocks from before the counting started are freed the same way
+struct TimeReport::AllocationCounters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocatedBytes{0};
+    std::atomic<int64_t> liveBytes{0};
+    std::atomic<int64_t> peakLiveBytes{0};
+};
+static std::atomic<bool> countingAllocations{false};
+static thread_local TimeReport::AllocationCounters ownCounters;
+static thread_local TimeReport::AllocationCounters* threadCounters = nullptr; // where this thread counts, its own if null
+
+static TimeReport::AllocationCounters& currentCounters() {
+    return threadCounters != nullptr ? *threadCounters : ownCounters;
+}
+
+static size_t blockSize(void* memory) {
+#ifdef _WIN32
+    return _msize(memory);
+#else
+    return malloc_usable_size(memory);
+#endif
+}
+
+static void* trackedAllocate(size_t size) {
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr || !countingAllocations.load(std::memory_order_relaxed)) {
+        return memory;
+    }
+    TimeReport::AllocationCounters& counters = currentCounters();
+    counters.allocations.fetch_add(1,std::memory_order_relaxed);
+    counters.allocatedBytes.fetch_add(size,std::memory_order_relaxed);
+    int64_t live = counters.liveBytes.fetch_add(blockSize(memory),std::memory_order_relaxed) + blockSize(memory);
+    int64_t peak = counters.peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peakLiveBytes.compare_exchange_weak(peak,live,std::memory_order_relaxed)) {
+    }
+    return memory;
+}
+
+static void trackedFree(void* memory) {
+    if (memory != nullptr && countingAllocations.load(std::memory_order_relaxed)) {
+        currentCounters().liveBytes.fetch_sub(blockSize(memory),std::memory_order_relaxed);
+    }
+    std::free(memory);
+}
+
+void* operator new(size_t size) {
+    void* pointer = trackedAllocate(size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size); }
+void operator delete(void* pointer) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { trackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { trackedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { trackedFree(pointer); }
+
+void TimeReport::countAllocations() {
+    countingAllocations.store(true);
+}
+
+TimeReport::AllocationCounters* TimeReport::threadAllocationCounters() {
+    return &currentCounters();
+}
+
+void TimeReport::countAllocationsInto(AllocationCounters* counters) {
+    threadCounters = counters;
+}
+
+void TimeReport::start(const std::string& stage) {
+    stop();
+    Stage newStage;
+    newStage.name = stage;
+    stages.push_back(newStage);
+    running = true;
+    AllocationCounters& counters = currentCounters();
+    startAllocations = counters.allocations;
+    startAllocatedBytes = counters.allocatedBytes;
+    startLiveBytes = counters.liveBytes;
+    counters.peakLiveBytes = startLiveBytes;
+    startTime = std::chrono::steady_clock::now();
+}
+
+void TimeReport::stop() {
+    if (!running) {
+        return;
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    const AllocationCounters& counters = currentCounters();
+    Stage& stage = stages.back();
+    stage.seconds = std::chrono::duration<double>(endTime - startTime).count();
+    stage.allocations = counters.allocations - startAllocations;
+    stage.allocatedBytes = counters.allocatedBytes - startAllocatedBytes;
+    stage.peakHeapBytes = counters.peakLiveBytes - startLiveBytes;
+    running = false;
+}
+
+void TimeReport::count(const std::string& counter, uint64_t value) {
+    counters.push_back({counter,value});
+}
+
+size_t TimeReport::peakRSSKilobytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on linux
+#endif
+}
+
+void TimeReport::print(std::ostream& out, bool printStages, bool printCounters) const {
+    if (printStages) {
+        out << "Time report for " << filename << ":\n";
+        double total = 0;
+        for (const Stage& stage : stages) {
+            total += stage.seconds;
+            out << "  " << stage.name << ": " << stage.seconds * 1000 << " ms, " << stage.allocations << " allocations, "
+            << stage.allocatedBytes << " bytes allocated, " << stage.peakHeapBytes << " bytes peak heap\n";
+        }
+        out << "  total: " << total * 1000 << " ms, peak RSS " << peakRSSKilobytes() << " KB\n";
+    }
+    if (printCounters) {
+        out << "Stats for " << filename << ":\n";
+        for (const auto& [name, value] : counters) {
+            out << "  " << name << ": " << value << "\n";
+        }
+    }
+}
+
+static void printJSONString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out << '\\' << ch;
+        }
+        else if ((unsigned char)ch < 0x20) {
+            static const char digits[] = "0123456789abcdef";
+            out << "\\u00" << digits[ch >> 4] << digits[ch & 0xF];
+        }
+        else {
+            out << ch;
+        }
+    }
+    out << '"';
+}
+
+void TimeReport::printJSON(std::ostream& out, bool printStages, bool printCounters) const {
+    out << "{\"file\": ";
+    printJSONString(out,filename);
+    if (printStages) {
+        out << ", \"stages\": [";
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const Stage& stage = stages[i];
+            out << (i == 0 ? "" : ", ") << "{\"name\": ";
+            printJSONString(out,stage.name);
+            out << ", \"seconds\": " << stage.seconds << ", \"allocations\": " << stage.allocations
+            << ", \"allocatedBytes\": " << stage.allocatedBytes << ", \"peakHeapBytes\": " << stage.peakHeapBytes << "}";
+        }
+        out << "], \"peakRSSKilobytes\": " << peakRSSKilobytes();
+    }
+    if (printCounters) {
+        out << ", \"counters\": {";
+        for (size_t i = 0; i < counters.size(); ++i) {
+            out << (i == 0 ? "" : ", ");
+            printJSONString(out,counters[i].first);
+            out << ": " << counters[i].second;
+        }
+        out << "}";
+    }
+    out << "}";
+}
\ No newline at end of file
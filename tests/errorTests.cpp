@@ -0,0 +1,106 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+// usage: errorTests [compiler] [directory]
+// compiles every .c file in the directory as one batch. each file starts with
+// "// error: <message>" and the compiler has to reject it with that message on
+// stderr, while the batch exits with 1 instead of crashing or hanging
+
+namespace fs = std::filesystem;
+
+static const std::string ERROR_PREFIX = "// error: ";
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    std::string compiler = "compiler.exe";
+#else
+    std::string compiler = "./compiler";
+#endif
+    std::string directory = "tests/errors";
+    if (argc >= 2) {
+        compiler = argv[1];
+    }
+    if (argc >= 3) {
+        directory = argv[2];
+    }
+    compiler = fs::absolute(compiler).string();
+
+    std::vector<fs::path> sources;
+    std::error_code error;
+    for (const fs::directory_entry& file : fs::directory_iterator(directory, error)) {
+        if (file.path().extension() == ".c") {
+            sources.push_back(file.path());
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+    if (sources.empty()) {
+        std::cerr << "No tests in " << directory << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> expected;
+    std::string command = "\"" + compiler + "\"";
+    for (const fs::path& source : sources) {
+        std::ifstream file(source);
+        std::string line;
+        std::getline(file, line);
+        if (line.rfind(ERROR_PREFIX, 0) != 0) {
+            std::cerr << source.string() << ": the first line has to be " << ERROR_PREFIX << "<message>\n";
+            return 1;
+        }
+        expected.push_back(line.substr(ERROR_PREFIX.size()));
+        command += " \"" + source.string() + "\"";
+    }
+    fs::path log = "errorTests.log";
+    command += " > \"" + log.string() + "\" 2>&1";
+
+    int status = std::system(command.c_str());
+#ifndef _WIN32
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+    std::vector<std::string> lines;
+    std::ifstream logFile(log);
+    std::string line;
+    while (std::getline(logFile, line)) {
+        lines.push_back(line);
+    }
+    logFile.close();
+    fs::remove(log);
+
+    size_t failures = 0;
+    // a file is reported as "<file>:<row>:<column> <message>" or "<file>: <message>"
+    for (size_t i = 0; i < sources.size(); ++i) {
+        std::string name = sources[i].string();
+        auto found = std::find_if(lines.begin(), lines.end(), [&](const std::string& line) {
+            return line.rfind(name + ":", 0) == 0;
+        });
+        if (found == lines.end()) {
+            std::cerr << name << ": no error, expected \"" << expected[i] << "\"\n";
+            ++failures;
+        }
+        else if (!endsWith(*found, expected[i])) {
+            std::cerr << name << ": got \"" << *found << "\", expected \"" << expected[i] << "\"\n";
+            ++failures;
+        }
+        fs::path object = sources[i];
+        fs::remove(object.replace_extension(".o"), error); // when it was compiled after all
+    }
+    std::cout << sources.size() - failures << " of " << sources.size() << " error tests passed\n";
+    if (status != 1) {
+        std::cerr << "the batch exited with " << status << ", expected 1\n";
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+// error: Division by zero in a constant expression
+int main() {
+    uint64_t a;
+    a = 1 / 0;
+    return a;
+}
\ No newline at end of file
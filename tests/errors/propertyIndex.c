@@ -0,0 +1,10 @@
+// error: Unexpected token in expression
+struct Node {
+    uint64_t data;
+};
+
+int main() {
+    struct Node node;
+    node.data = 1;
+    return node.data[5];
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+// error: Unexpected token in expression
+int main() {
+    uint64_t a;
+    a = 1 + uint64_t;
+    return a;
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+// error: undeclared identifier zz
+int main() {
+    zz = 1;
+    return 0;
+}
\ No newline at end of file
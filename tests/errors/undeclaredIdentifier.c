@@ -0,0 +1,4 @@
+// error: undeclared identifier zz
+int main() {
+    return zz;
+}
\ No newline at end of file
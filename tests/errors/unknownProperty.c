@@ -0,0 +1,10 @@
+// error: struct Point has no property z
+struct Point {
+    uint64_t x;
+};
+
+int main() {
+    struct Point point;
+    point.x = 1;
+    return point.z;
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+// error: undeclared identifier zz
+void nothing() {
+    return;
+}
+int main() {
+    nothing();
+    return zz;
+}
\ No newline at end of file